@@ -13,8 +13,25 @@
 #define GOODIE_W (TILE_SIZE / 4) /* Width and height of goodie */
 #define GOODIE_H (TILE_SIZE / 4) /* rect in pixels. */
 
-#define LEVEL_W 40 /* Width and height of */
-#define LEVEL_H 30 /* the level in tiles. */
+#define LEVEL_W 40 /* Default width and height */
+#define LEVEL_H 30 /* of levels in tiles.      */
+
+#define LEVEL_MAX   320 /* Largest width or height of a level, so that pixel positions fit in an 'SDL_Rect'. */
+#define LEVEL_CHUNK 16  /* Width and height of the chunks levels are stored in, in tiles. */
+#define LEVEL_DOORS 4   /* Most doors in a level that only block with their right half. */
+
+#define PATH_SIZE 128 /* Maximum number of nodes in a zombie path. */
+
+#define NUM_ZOMBIES 6  /* Default number of zombies and goodies in each */
+#define NUM_GOODIES 12 /* level, can be changed with '-z' and '-g'.     */
+
+#define PATH_BUDGET 2000 /* Default number of nodes zombies may search each frame. */
+
+#define DIRTY_MAX 128 /* Changed rects kept each frame, any more are merged into the last one. */
+
+#define WORLD_CHUNK 256 /* Width and height of the chunks the world is drawn in, in pixels. */
+
+#define CAMERA_MARGIN (TILE_SIZE / 2) /* Pixels around the camera that entities are still drawn in. */
 
 /* Path for data files. Relative path by default, this can be set during
  * compilation and can be changed at run-time by supplying the '-d' option. */
@@ -28,6 +45,46 @@
 
 typedef _Bool bool;
 
+/* Location on the map according to isometric projection. */
+struct iso { int x, y; };
+
+/* Position of a tile in the 'level' array. */
+struct node { int x, y; };
+
+/* Tiles of a level of any size, kept chunk by chunk with each chunk holding
+ * 'LEVEL_CHUNK' columns of 'LEVEL_CHUNK' tiles, so that tiles near each other
+ * are near each other in memory as well. Chunks follow each other row by row,
+ * and each row of chunks takes up a power of two so that positions and indices
+ * are quick to work out from each other. Other arrays with an entry for each
+ * tile use the same layout and are indexed with 'LEVEL_INDEX()'. */
+struct level_map {
+	int w, h;		/* Size of the level in tiles. */
+	int chunks_w, chunks_h;	/* Size of the level in chunks, rounded up. */
+	int chunks_shift;	/* 'chunks_w' is rounded up to '1 << chunks_shift'. */
+	char *tiles;
+};
+
+/* Index of tile 'x', 'y' of 'map' in its tiles and every other per-tile array.
+ * Positions are never negative, so they are worked out unsigned, which turns
+ * the divisions into plain shifts. */
+#define LEVEL_INDEX(map, x, y) ((int) \
+	((((unsigned) (y) / LEVEL_CHUNK) << (map)->chunks_shift) * (LEVEL_CHUNK * LEVEL_CHUNK) + \
+	 (unsigned) (x) * LEVEL_CHUNK + (unsigned) (y) % LEVEL_CHUNK))
+
+/* Position of the tile at 'index' in 'map', the other way round from 'LEVEL_INDEX()'. */
+#define LEVEL_X(map, index) ((int) \
+	(((unsigned) (index) / LEVEL_CHUNK) & ((map)->chunks_w * LEVEL_CHUNK - 1)))
+#define LEVEL_Y(map, index) ((int) \
+	(((unsigned) (index) / (LEVEL_CHUNK * LEVEL_CHUNK) >> (map)->chunks_shift) * LEVEL_CHUNK + \
+	 (unsigned) (index) % LEVEL_CHUNK))
+
+/* Tile 'x', 'y' of 'map'. */
+#define LEVEL_TILE(map, x, y) ((map)->tiles[LEVEL_INDEX(map, x, y)])
+
+/* Number of entries in per-tile arrays for 'map', including the unused tiles
+ * that fill up the chunks past the right and bottom edges. */
+#define LEVEL_SIZE(map) ((map)->chunks_w * (map)->chunks_h * LEVEL_CHUNK * LEVEL_CHUNK)
+
 /* 
  * Shuts down SDL and exits cleanly, optionally emitting an error message
  * if code != 0. Returns code to the system.
@@ -38,27 +95,106 @@ struct game_data {
 	/* Various bookkeeping variables for the game. */
 	char *datadir;
 	int num_levels;
+	const struct pack_header *pack;	/* Mapped level pack, or NULL to read text files. */
+	struct level_variant *cache;	/* Every variant of every level, see 'levels.h'. */
 	int screen_w, screen_h;
+	int pathfinder;		/* Algorithm used for zombie paths, as defined in 'path.h'. */
+	bool maze;		/* Play generated levels instead, set with '-m'. */
+	int maze_w, maze_h;	/* Size of generated levels in tiles. */
 
 	/* In order to scroll our level, we first paint everything to
 	 * 'world', then we copy whatever is in the 'camera' rect to
-	 * our screen via 'SDL_BlitSurface()'. */
-	SDL_Surface *world;
+	 * our screen via 'SDL_BlitSurface()'. Only the chunks of the world
+	 * around the camera are kept, each drawn when it comes into view and
+	 * dropped once it is the one left out of view the longest, see
+	 * 'graphics_world_view()'. Drawing to chunks that aren't kept does
+	 * nothing. */
+	struct world {
+		int w, h;		/* Size of the world in pixels. */
+		int chunks_w, chunks_h;	/* Size of the world in chunks, rounded up. */
+		int *chunk;		/* Slot each chunk is kept in, or -1, row by row. */
+
+		int size;		/* Number of chunks there is room for. */
+		struct world_slot {
+			SDL_Surface *surface;	/* 'WORLD_CHUNK' pixels on either side. */
+			int chunk;		/* Chunk kept in the slot, or -1. */
+			Uint32 used;		/* View the chunk was last in. */
+		} *slot;
+
+		Uint32 view;		/* Bumped by each 'graphics_world_view()'. */
+	} world;
+
 	SDL_Surface *screen;
 	SDL_Joystick *joystick;
+	const struct render_backend *render;	/* Draws the game, set with '-r', see 'render.h'. */
 
-	/* This array represents our level, and is automatically populated
+	/* This map represents our level, and is automatically populated
 	 * by the level_generate function. Different characters correspond
-	 * to different tiles. */
-	char level[LEVEL_H][LEVEL_W];
+	 * to different tiles. The arrays below have an entry for each tile
+	 * and are resized along with it, see 'level_resize()'. */
+	struct level_map level;
+	int num_floor;		/* Number of floor tiles in 'level' as loaded. */
+	struct node *spawn;	/* Those floor tiles in no particular order, see 'level_entities_set()'. */
+
+	/* Visibility between each tile and the tiles up to 'LEVEL_SIGHT' away from
+	 * it, as computed by 'level_tile_visible()'. Visibility works both ways,
+	 * so each tile only keeps one bit for the tiles after it, row by row. */
+	Uint64 *sight;
 
-	/* This array keeps track of all wall tiles on the level. */
-	SDL_Rect wall[LEVEL_H][LEVEL_W];
+	/* Regions of the level zombies can walk between, numbered from 0, with -1
+	 * for tiles nobody can walk on. The floor tiles of region 'r' are listed
+	 * in 'region_tiles', from 'region_first[r]' up to 'region_first[r + 1]'. */
+	int *region;
+	int num_regions;
+	int *region_first;
+	struct node *region_tiles;
+
+	/* Two bits for each tile, sixteen tiles to a word in the order given by
+	 * 'LEVEL_INDEX()', set if the tile is solid to the player and to zombies
+	 * respectively, see 'level_solid()'. Doors listed in 'door' only block
+	 * with their right half, as that is where they are drawn. */
+	Uint32 *solid;
+	int door[LEVEL_DOORS];
+	int num_doors;
+
+	/* Next level to be played, picked as soon as the current level starts and
+	 * generated in the background with '-m', see 'level_preload()'. */
+	struct level_next {
+		bool ready;		/* A level has been picked. */
+		int index;		/* Level picked, as kept in 'cache'. */
+		Uint32 seed;		/* Seed of the level to generate, with '-m'. */
+
+		SDL_Thread *thread;	/* Thread generating the level, or NULL if there is none. */
+	} next;
 
 	/* Camera acts as a viewport which follows the player around and draws
 	 * the level around the player according to the 'level' array. */
 	SDL_Rect camera;
 
+	/* Parts of 'world' that changed since 'screen' was last updated, in world
+	 * pixels, so that only those need drawing again and copying, see
+	 * 'graphics_screen_update()'. */
+	struct dirty {
+		SDL_Rect rect[DIRTY_MAX];
+		int num_rects;
+		bool all;		/* Draw the whole screen again instead. */
+		SDL_Rect camera;	/* Camera as it was when 'screen' was last updated. */
+	} dirty;
+
+	/* Zombies and the player as they are drawn to the world this frame, back
+	 * to front, see 'graphics_screen_update()'. Only those near the camera
+	 * are drawn, and the world holds no other trace of them. */
+	struct sprites {
+		struct sprite {
+			SDL_Rect rect;		/* Where it is on the world. */
+			SDL_Surface *image;	/* Drawn from its top left corner. */
+			Uint16 depth;		/* Drawn over sprites of less depth. */
+		} *sprite, *sorted;	/* 'sorted' is only used while sorting. */
+
+		int num_sprites;
+		int size;		/* Number of sprites there is room for. */
+	} sprites;
+
 	int cur_level;		/* Current level in game. */
 	Sint32 score;		/* Game score for the current session. */
 	Uint32 score_scale;	/* The score in which we will gain our next life. */
@@ -69,33 +205,81 @@ struct game_data {
 
 	struct pc {
 		SDL_Rect rect;	/* Persistent rect for the player character. */
-		SDL_Surface *bg;	/* Background surface for redrawing etc. */
-		int iso_x, iso_y;	/* Location on map according to isometric projection. */
+		struct iso iso;	/* Location on map according to isometric projection. */
+
+		bool drawn;		/* Drawn to the world at 'shown' last frame. */
+		struct iso shown;
 
 		bool dead;		/* Are we dead? */
 		int lives;		/* Number of retries for the current session. */
 		int dir_x, dir_y;	/* Direction of player on the X / Y axis. */
 	} player;
 
+	/* Zombies and goodies are kept as a struct of arrays, where each entity
+	 * is made up of the elements at the same index in every array. Passes
+	 * over them only touch the fields they need, and the arrays grow to fit
+	 * 'num_zombies' and 'num_goodies', see 'level_entities_alloc()'. */
 	int num_zombies;	/* Number of zombies in the level. */
 
-	struct npc {
-		SDL_Rect rect;	/* Persistent rect for the zombies. */
-		SDL_Surface *bg;	/* Background surface for redrawing etc. */
-		int iso_x, iso_y;	/* Location on map according to isometric projection. */
+	struct horde {
+		int size;		/* Number of zombies the arrays have room for. */
+
+		SDL_Rect *rect;		/* Persistent rects for the zombies. */
+		struct iso *iso;	/* Location on map according to isometric projection. */
+		struct node *dest;	/* Destination on the X / Y axis. */
+
+		int *num_nodes;		/* Number of nodes in each path. */
+		struct node *path;	/* 'PATH_SIZE' nodes for each zombie, see 'ZOMBIE_PATH()'. */
 
-		struct node { int x, y; } path[64];
-		int num_nodes;		/* Number of nodes in path. */
-		int dest_x, dest_y;	/* Destination on the X / Y axis. */
-	} zombie[16];
+		Uint32 *seed;		/* State of each zombie's own random sequence. */
+
+		int *request;		/* Whether we are waiting for a path, see 'zombie.h'. */
+		int *ticket;		/* Bumped to call off the path we are waiting for. */
+		struct node *want;	/* Destination of the path we are waiting for. */
+
+		int *cell;		/* Tile each zombie is filed under in 'zombie_grid'. */
+		int *cell_next;		/* Next zombie filed under the same tile, or -1. */
+
+		bool *drawn;		/* Drawn to the world at 'shown' last frame. */
+		struct iso *shown;
+	} zombie;
+
+	/* Zombies filed under the tile they stand on, so that collisions only
+	 * need checking against zombies in neighbouring tiles. Holds the first
+	 * zombie for each tile, or -1, see 'zombie_grid_build()'. */
+	int *zombie_grid;
+
+	/* Paths zombies are waiting for, searched for in the order they were asked
+	 * for and only up to 'budget' nodes each frame, see 'zombie_move()'. */
+	struct path_queue {
+		struct path_request {
+			int zombie;		/* Zombie waiting for the path. */
+			int ticket;		/* Zombie's ticket when it asked. */
+			struct node src, dest;
+		} *request;
+
+		int size;		/* Number of requests there is room for. */
+		int head, len;		/* First request waiting, and how many do. */
+		bool busy;		/* The first request is being searched for. */
+		int budget;		/* Nodes to expand each frame, set with '-b'. */
+	} path_queue;
 
 	int num_goodies;	/* Number of goodies in the level. */
 	
 	struct prize {
-		SDL_Rect rect;	/* Persistent rect for the goodies in the level. */
-		SDL_Surface *bg;	/* Background surface for redrawing etc. */
-		int iso_x, iso_y;	/* Location on map according to isometric projection. */
-	} goodie[16];
+		int size;		/* Number of goodies the arrays have room for. */
+
+		SDL_Rect *rect;		/* Persistent rects for the goodies in the level. */
+		struct iso *iso;	/* Location on map according to isometric projection. */
+
+		int *cell;		/* Tile each goodie is filed under in 'goodie_grid'. */
+		int *cell_next;		/* Next goodie filed under the same tile, or -1. */
+	} goodie;
+
+	/* Goodies filed under the tile their top left corner lies on, so that the
+	 * player can find the ones it runs into. Holds the first goodie for each
+	 * tile, or -1, see 'level_goodie_first()'. */
+	int *goodie_grid;
 
 	struct {
 		SDL_Surface *font;
@@ -2,24 +2,40 @@
 #define GRAPHICS_H
 
 /* 
- * Clears 'entity' from the screen.
+ * Convert 'rect' from SDL coordinates to isometric coordinates.
  */
-void graphics_entity_clear(struct game_data *game, struct pc *entity);
+struct iso graphics_iso_convert(struct game_data *game, SDL_Rect rect);
 
 /* 
- * Convert from SDL coordinates to isometric coordinates.
+ * Marks 'w' by 'h' pixels at 'iso' on 'world' as changed, so that they are
+ * drawn again and copied to the screen on the next 'graphics_screen_update()'.
  */
-void graphics_iso_convert(struct pc *entity);
+void graphics_dirty_add(struct game_data *game, struct iso iso, int w, int h);
 
 /* 
- * Animates and draws 'entity' of 'type' (defined in levels.h) on screen.
+ * Draws level generated by 'level_generate()', resizing 'world' to fit it first.
+ * Only the chunks in view of 'camera' are drawn right away.
  */
-void graphics_entity_draw(struct game_data *game, const int entity_type, struct pc *entity);
+void graphics_level_draw(struct game_data *game);
 
 /* 
- * Draws level generated by 'level_generate()'.
+ * Draws the part of 'level' at 'area' of the world to 'surface', with the top
+ * left corner of 'area' at 'pos_x', 'pos_y', leaving the rest of 'surface' alone.
  */
-void graphics_level_draw(struct game_data *game);
+void graphics_level_render(struct game_data *game, SDL_Surface *surface, const struct level_map *level, SDL_Rect area, int pos_x, int pos_y);
+
+/* 
+ * Draws the chunks of 'world' in view of 'camera' that aren't kept already,
+ * dropping the chunks that have been out of view the longest to make room.
+ */
+void graphics_world_view(struct game_data *game);
+
+/* 
+ * Copies 'rect' of 'world' to 'surface', with its top left corner at 'x', 'y',
+ * or the other way round if 'to_world' is set. Parts of 'rect' on chunks that
+ * aren't kept are left alone.
+ */
+void graphics_world_blit(struct game_data *game, SDL_Rect rect, SDL_Surface *surface, int x, int y, bool to_world);
 
 /* 
  * Draws 'text' on 'screen' surface with offsets 'pos_x' and 'pos_y' on the
@@ -29,16 +45,16 @@ void graphics_level_draw(struct game_data *game);
 void graphics_text_draw(struct game_data *game, const char *text, int pos_x, int pos_y);
 
 /* 
- * Draws tile 'tile_name' to 'dest' rect. Tile types are the same as
+ * Draws tile 'tile_name' to 'dest' rect on 'world'. Tile types are the same as
  * defined in 'level.h'.
  */
-void graphics_tile_draw(struct game_data *game, const int tile_type, SDL_Rect tile);
+void graphics_tile_draw(struct game_data *game, SDL_Surface *world, const int tile_type, SDL_Rect tile);
 
 /* 
- * Initializes and optimizes surface for rendering. Returns pointer to
- * optimized SDL_Surface.
+ * Initializes and optimizes surface for rendering with 'game->render'. Returns
+ * pointer to optimized SDL_Surface.
  */
-SDL_Surface *graphics_surface_init(int width, int height);
+SDL_Surface *graphics_surface_init(struct game_data *game, int width, int height);
 
 /* 
  * Load graphics (level tiles, font, player and zombie animations) into
@@ -50,21 +66,19 @@ void graphics_assets_load(struct game_data *game);
  * Loads an image pointed to by 'filename', optimises it and returns a
  * pointer to the resulting optimized image surface.
  */
-SDL_Surface *graphics_image_load(const char *filename);
-
-/* 
- * Copies from 'game.world' surface to 'entity.bg' surface using 'entity'
- * position and size as offsets.
- */
-void graphics_entity_store(struct game_data *game, struct pc *entity);
+SDL_Surface *graphics_image_load(struct game_data *game, const char *filename);
 
 /* 
- * Updates and redraws text on the screen.
+ * Updates the text shown on the screen, drawing the text that changed to a
+ * surface of its own for 'graphics_screen_update()' to show in a single blit.
  */
 void graphics_text_update(struct game_data *game);
 
 /* 
- * Updates and redraws screen.
+ * Draws the zombies and the player near the camera to 'world' back to front,
+ * drawing the world again from the level up where they moved, and updates the
+ * screen, copying only the parts of 'world' that changed or scrolled into view,
+ * unless 'game->dirty.all' is set.
  */
 void graphics_screen_update(struct game_data *game);
 
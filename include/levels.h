@@ -10,11 +10,35 @@
 #define TILE_GOODIE		'g'
 #define TILE_UNWALKABLE	'x'
 
+/* Entities tiles can be solid to, see 'level_solid()'. */
+#define SOLID_PLAYER 1 /* Walls and closed doors. */
+#define SOLID_ZOMBIE 2 /* Walls and tiles zombies can't walk on. */
+
+/* Distance in tiles, on either axis, up to which zombies can see the player. */
+#define LEVEL_SIGHT 5
+
+/* Distance in tiles from the entrance, on either axis, from which zombies can be placed. */
+#define LEVEL_SPAWN 4
+
 /* Entity type definitions. */
 #define ENTITY_PLAYER	'p'
 #define ENTITY_ZOMBIE	'z'
 #define ENTITY_GOODIE	'g'
 
+/* Level as loaded in one of its orientations, along with everything worked out
+ * from its tiles, kept for every level by 'level_cache_build()' so that loading
+ * a level only has to copy it into 'game'. The cache has one more slot after the
+ * levels in the data directory, for the last level generated. */
+struct level_variant {
+	struct level_map level;
+	int num_floor;
+	Uint64 *sight;
+	int *region;
+	int num_regions;
+	int *region_first;
+	struct node *region_tiles;
+};
+
 /* 
  * Clear level array from data without regenerating.
  */
@@ -27,17 +51,106 @@ void level_clear(struct game_data *game);
 bool level_collision(SDL_Rect entity, SDL_Rect wall);
 
 /* 
- * Generate random level.
+ * Returns true if tile 'x', 'y' blocks the entities in 'solid', which is one or
+ * more of 'SOLID_PLAYER' and 'SOLID_ZOMBIE'. Tiles beyond the edges of the level
+ * block everyone.
+ */
+bool level_solid(struct game_data *game, int x, int y, int solid);
+
+/* 
+ * Returns the rect in world pixels that entities run into at tile 'x', 'y',
+ * which is the whole tile other than for doors.
+ */
+SDL_Rect level_wall(struct game_data *game, int x, int y);
+
+/* 
+ * Rebuild 'game->solid' and the list of doors for the whole level.
+ */
+void level_solid_build(struct game_data *game);
+
+/* 
+ * Update 'game->solid' for tile 'x', 'y' after it has changed.
+ */
+void level_solid_update(struct game_data *game, int x, int y);
+
+/* 
+ * Set 'map' up for a level of 'w' by 'h' tiles, reallocating its tiles and
+ * filling them with 'TILE_UNWALKABLE'. Exits if the level is larger than
+ * 'LEVEL_MAX' or too small to have a border.
+ */
+void level_map_init(struct level_map *map, int w, int h);
+
+/* 
+ * Resize the level in 'game' and every array with an entry for each of its tiles
+ * to 'w' by 'h' tiles, keeping them as they are if the size has not changed.
+ */
+void level_resize(struct game_data *game, int w, int h);
+
+/* 
+ * Find the levels in the data directory, mapping the level pack built by
+ * 'spooky-levelc' if there is one and counting the text files otherwise.
+ * Returns the number of levels found, which is also kept in 'game->num_levels'.
+ */
+int level_index(struct game_data *game);
+
+/* 
+ * Generate random level, picking one of the levels in the data directory, or
+ * generating a new one with 'maze_generate()' if 'game->maze' is set.
  */
 void level_generate(struct game_data *game);
 
+/* 
+ * Pick the level to play after the current one, using the same draws as
+ * 'level_generate()', and start generating it in the background with '-m'.
+ */
+void level_preload(struct game_data *game);
+
+/* 
+ * Load the level picked by 'level_preload()', waiting for it to be generated
+ * if need be. Generates a level instead if none was picked.
+ */
+void level_advance(struct game_data *game);
+
+/* 
+ * Read every level found by 'level_index()' and work out each of its mirrored
+ * and flipped variants into 'game->cache'.
+ */
+void level_cache_build(struct game_data *game);
+
+/* 
+ * Load level 'number' from 'game->cache' into 'level', mirrored and flipped if
+ * 'mirror' and 'flip' are set, building the cache first if there is none yet.
+ */
+void level_load(struct game_data *game, int number, bool mirror, bool flip);
+
 /* 
  * Determine if element in position 'src_x', 'src_y' can see element in position
  * 'dst_x', 'dst_y' and vice versa, using 'level' to determine obstructions.
  * Positions are relative to indices in 'level'. Returns 'true' or 'false',
  * if elements were found to be visible to each other or not, respectively.
  */
-int level_tile_visible(int src_x, int src_y, int dest_x, int dest_y, char level[LEVEL_H][LEVEL_W]);
+int level_tile_visible(int src_x, int src_y, int dest_x, int dest_y, const struct level_map *level);
+
+/* 
+ * Same as 'level_tile_visible()', but looks the answer up in 'game->sight' for tiles
+ * within 'LEVEL_SIGHT' of each other, instead of walking between them.
+ */
+bool level_sight(struct game_data *game, int src_x, int src_y, int dest_x, int dest_y);
+
+/* 
+ * Rebuild 'game->sight' for the whole level.
+ */
+void level_sight_build(struct game_data *game);
+
+/* 
+ * Rebuild 'game->sight' around tile 'x', 'y' after it has changed.
+ */
+void level_sight_update(struct game_data *game, int x, int y);
+
+/* 
+ * Rebuild the walkable regions in 'game->region' and their lists of floor tiles.
+ */
+void level_regions_build(struct game_data *game);
 
 /* 
  * Clears the exit door on the right of the level once certain conditions have been met.
@@ -45,7 +158,29 @@ int level_tile_visible(int src_x, int src_y, int dest_x, int dest_y, char level[
 void level_unlock(struct game_data *game);
 
 /* 
- * Place entities (player, zombies, goodies) within the level.
+ * Grow the zombie and goodie arrays in 'game' to fit 'num_zombies' and
+ * 'num_goodies' entities, keeping the ones already there.
+ */
+void level_entities_alloc(struct game_data *game);
+
+/* 
+ * Returns the first goodie filed under tile 'x', 'y' in 'game->goodie_grid', or
+ * -1 if there are none or the tile is outside the level. The others follow
+ * by following 'game->goodie.cell_next'.
+ */
+int level_goodie_first(struct game_data *game, int x, int y);
+
+/* 
+ * Remove goodie 'i' from the goodie arrays and 'game->goodie_grid', moving the
+ * last goodie into its place, and turn its tile back into floor if no goodies
+ * are left on it.
+ */
+void level_goodie_remove(struct game_data *game, int i);
+
+/* 
+ * Place entities (player, zombies, goodies) within the level, each goodie on a
+ * floor tile of its own and zombies away from the entrance, for as long as there
+ * are floor tiles left for them.
  */
 void level_entities_set(struct game_data *game);
 
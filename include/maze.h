@@ -0,0 +1,21 @@
+#ifndef MAZE_H
+#define MAZE_H
+
+#define MAZE_WALLS  48 /* Wall segments scattered over a generated level of the default size. */
+#define MAZE_LENGTH 9  /* Longest wall segment in tiles. */
+#define MAZE_TRIES  16 /* Levels generated before settling for an empty room. */
+
+/* Least share of the level, in percent, that has to be left as floor. */
+#define MAZE_FLOOR 55
+
+/*
+ * Generate a level into 'level', filling its whole size, which has to be at least
+ * 3 tiles on either side, following the same rules as the levels in the data
+ * directory: surrounded by walls, with a door on the left for an entrance
+ * and another on the right for an exit. Every floor tile can be reached from
+ * the entrance, as can the exit. The same 'seed' always generates the same
+ * level. Returns the number of floor tiles in the level.
+ */
+int maze_generate(struct level_map *level, Uint32 seed);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PACK_H
+#define PACK_H
+
+#define PACK_MAGIC   0x4b504d53 /* "SMPK" when read back on little-endian machines. */
+#define PACK_VERSION 2
+
+/* Level pack built by 'spooky-levelc' out of the text files in 'data/levels', so
+ * that levels can be mapped into memory as they are instead of being parsed. The
+ * header is followed by 'num_levels' levels, one after the other. */
+struct pack_header {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 num_levels;
+	Uint32 checksum;	/* Checksum of every level after the header. */
+};
+
+/* Header of each level, followed by its 'w * h' tiles row by row as found in the
+ * text file, padded to 'PACK_LEVEL_SIZE()' bytes so that the next one lines up. */
+struct pack_level {
+	Uint32 w, h;		/* Size of the level in tiles. */
+	Uint32 num_floor;	/* Number of floor tiles in the level. */
+	char tiles[];
+};
+
+/* Size of a level of 'w' by 'h' tiles in the pack, header included. */
+#define PACK_LEVEL_SIZE(w, h) (sizeof(struct pack_level) + (((w) * (h) + 3) & ~3))
+
+/*
+ * Read a level in the text format described in the README from 'file', skipping
+ * spaces, and setting 'w' and 'h' to its size. The level ends with the file or
+ * with the first blank line. Returns its tiles row by row in memory the caller
+ * has to free, or NULL if its rows differ in length or it is too large.
+ */
+char *pack_parse(FILE *file, int *w, int *h);
+
+/*
+ * Returns the checksum of 'size' bytes at 'data', as kept in 'pack_header'.
+ */
+Uint32 pack_checksum(const void *data, size_t size);
+
+/*
+ * Map the level pack in 'filename' into memory. Returns NULL if it is missing,
+ * or if it was built for a different version or is damaged, in which case
+ * levels should be read from their text files instead.
+ */
+const struct pack_header *pack_map(const char *filename);
+
+/*
+ * Returns level 'number' in 'pack'.
+ */
+const struct pack_level *pack_level(const struct pack_header *pack, int number);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef PATH_H
+#define PATH_H
+
+#define PATH_COST_STRAIGHT 10 /* Cost of moving to a tile horizontally or vertically. */
+#define PATH_COST_DIAGONAL 14 /* Cost of moving to a tile diagonally. */
+
+#define PATH_PENDING -1 /* Returned by 'path_resume()' while a search is still running. */
+
+/* Pathfinding algorithms, selected with the '-p' option. */
+#define PATH_ASTAR 0 /* Plain A*, expanding every tile along the way. */
+#define PATH_JUMP  1 /* Jump Point Search, faster in large open areas. */
+
+/*
+ * Search for the shortest path from tile 'src_x', 'src_y' to tile 'dest_x', 'dest_y'
+ * in 'level', using the A* algorithm over an indexed binary heap. The path is copied
+ * into 'path' starting with the destination at index 1 and ending with the source,
+ * keeping at most 'size - 1' nodes closest to the source if the path is longer than
+ * that. Returns the index of the source node in 'path', or 0 if no path was found.
+ */
+int path_search(const struct level_map *level, int src_x, int src_y, int dest_x, int dest_y,
+		struct node *path, int size);
+
+/*
+ * Same as 'path_search()', but using Jump Point Search, which skips over tiles in
+ * open areas instead of expanding them one by one. Paths found have the same cost
+ * as the ones found by 'path_search()', though they may take a different route.
+ */
+int path_jump_search(const struct level_map *level, int src_x, int src_y, int dest_x, int dest_y,
+		     struct node *path, int size);
+
+/*
+ * Start a search like 'path_search()', or 'path_jump_search()' if 'jump' is set,
+ * to be carried out a little at a time by 'path_resume()'. Only one such search
+ * can run at once, starting another abandons the last one. Returns false if no
+ * path can be found, in which case there is nothing to resume.
+ */
+bool path_begin(const struct level_map *level, int src_x, int src_y, int dest_x, int dest_y, bool jump);
+
+/*
+ * Continue the search started by 'path_begin()', expanding at most '*budget' nodes
+ * and taking the number expanded off '*budget'. Returns 'PATH_PENDING' if the
+ * budget ran out before the search ended, otherwise the same as 'path_search()'.
+ */
+int path_resume(const struct level_map *level, int *budget, struct node *path, int size);
+
+/*
+ * Build a flow field over 'level' leading towards tile 'dest_x', 'dest_y', using
+ * Dijkstra's algorithm with the same movement rules as 'path_search()'. The field
+ * is shared, so that every entity heading for the same tile can read its next step
+ * from it instead of running a search of its own. Must not be called while other
+ * threads are searching.
+ */
+void path_flow_build(const struct level_map *level, int dest_x, int dest_y);
+
+/*
+ * Invalidate the flow field. Must be called whenever the walkable tiles in the
+ * level change.
+ */
+void path_flow_reset(void);
+
+/*
+ * Returns true if the flow field is up to date and leads towards 'dest_x', 'dest_y'.
+ */
+bool path_flow_ready(int dest_x, int dest_y);
+
+/*
+ * Copy the path from 'src_x', 'src_y' to the flow field destination into 'path',
+ * using the same layout and return value as 'path_search()'.
+ */
+int path_flow_search(int src_x, int src_y, struct node *path, int size);
+
+/*
+ * Number the regions of 'level' that can be walked between with the same moves
+ * as 'path_search()', filling 'region' with the region each tile belongs to, or
+ * -1 for tiles that cannot be walked on, indexed with 'LEVEL_INDEX()'. Returns
+ * the number of regions.
+ */
+int path_regions(const struct level_map *level, int *region);
+
+/*
+ * Returns the number of nodes expanded by the last search on this thread.
+ */
+int path_expanded(void);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+/* Render backends, selected with the '-r' option. */
+#define RENDER_SDL    0 /* Draw to a window through SDL. */
+#define RENDER_BUFFER 1 /* Draw to a pixel buffer in memory, with no display needed. */
+#define RENDER_NULL   2 /* Leave out drawing altogether, keeping only the game itself. */
+
+#define RENDER_BACKENDS 3
+
+/* Everything 'graphics.c' draws goes through one of these, picked when the
+ * game starts and kept in 'game->render'. Surfaces are SDL surfaces with
+ * every backend, so that sizes and formats still work out the same way. The
+ * drawing functions take the same arguments as 'SDL_BlitSurface()', with
+ * 'image' drawn to 'surface', or as 'SDL_FillRect()'. */
+struct render_backend {
+	const char *name;	/* As given to '-r'. */
+	Uint32 subsystems;	/* What to pass to 'SDL_Init()'. */
+	bool display;		/* Shows frames as they are drawn, in real time. */
+
+	/* Sets up a screen of 'w' by 'h' pixels, fullscreen if 'fullscreen' is
+	 * set, returning NULL on failure. */
+	SDL_Surface *(*screen_init)(int w, int h, bool fullscreen);
+
+	/* Returns a surface of 'w' by 'h' pixels in the format of the screen, or
+	 * NULL on failure. */
+	SDL_Surface *(*surface_init)(int w, int h);
+
+	/* Returns a copy of 'image' in the format of the screen, alpha and all, or
+	 * NULL on failure. */
+	SDL_Surface *(*image_convert)(SDL_Surface *image);
+
+	/* Draws tiles of the level, and fills in the parts of it that aren't. */
+	void (*level_draw)(SDL_Surface *image, SDL_Rect *src, SDL_Surface *surface, SDL_Rect *dst);
+	void (*level_fill)(SDL_Surface *surface, SDL_Rect *dst, Uint32 color);
+
+	/* Draws goodies, zombies and the player over the level. */
+	void (*sprite_draw)(SDL_Surface *image, SDL_Rect *src, SDL_Surface *surface, SDL_Rect *dst);
+
+	/* Draws glyphs of the font, or info text drawn from them. */
+	void (*text_draw)(SDL_Surface *image, SDL_Rect *src, SDL_Surface *surface, SDL_Rect *dst);
+
+	/* Copies what has been drawn as it is, from the world to the screen or
+	 * within the screen. */
+	void (*copy)(SDL_Surface *image, SDL_Rect *src, SDL_Surface *surface, SDL_Rect *dst);
+
+	/* Shows the 'num_rects' rects in 'rect' of 'screen', or all of it if
+	 * 'rect' is NULL. */
+	void (*present)(SDL_Surface *screen, int num_rects, SDL_Rect *rect);
+};
+
+/* Backends by number, as defined above. */
+extern const struct render_backend render_backends[RENDER_BACKENDS];
+
+#endif
@@ -3,30 +3,59 @@
 
 #define ZOMBIE_SPEED 180 /* Walking speed of zombies in pixels per second. */
 
-#define ZOMBIE(i)    game->zombie[i]						/* Current zombie. */
-#define ZOMBIE_X(i) (game->zombie[i].rect.x / TILE_SIZE)	/* Current zombie position in     */
-#define ZOMBIE_Y(i) (game->zombie[i].rect.y / TILE_SIZE)	/* relation to the 'level' array. */
+#define ZOMBIE_LOOKAHEAD 3 /* Nodes left on our path when we ask for the next one. */
 
-#define ZOMBIE_NODE(i) ZOMBIE(i).path[ZOMBIE(i).num_nodes] /* Current occupied node. */
+/* Whether a zombie is waiting for a path, as kept in 'game->zombie.request'. */
+#define ZOMBIE_IDLE    0 /* Not waiting for anything. */
+#define ZOMBIE_ASKING  1 /* Picked a destination, about to be queued. */
+#define ZOMBIE_WAITING 2 /* Queued in 'game->path_queue'. */
 
-/* Used in 'zombie_path_search()', this defines how long we will search for the destination.
- * Larger numbers mean more chances of success, but also more time spent searching. */
-#define SEARCH_DEPTH 64
+#define ZOMBIE_X(i) (game->zombie.rect[i].x / TILE_SIZE)	/* Current zombie position in     */
+#define ZOMBIE_Y(i) (game->zombie.rect[i].y / TILE_SIZE)	/* relation to the 'level' array. */
 
-/* Used for storing the path generated by 'zombie_path_search()'. */
-struct list {
-	int x, y;				/* The node's location on the X / Y axis. */
-	int f, g, h;			/* Information about the node, as per the A* algoarithm. */
-	bool dropped;			/* Have we already walked this node? */
-	struct list *parent;	/* The parent node for each node. */
-};
+#define ZOMBIE_PATH(i) (game->zombie.path + (i) * PATH_SIZE)			/* Path of zombie. */
+#define ZOMBIE_NODE(i) ZOMBIE_PATH(i)[game->zombie.num_nodes[i]]	/* Current occupied node. */
 
 /* 
- * Calculate path for 'zombie' looking for walls and other obstructions along the way
- * in 'level'. Copies the path in the 'path' structure belonging to 'zombie' and
- * returns the number of nodes. An implementation of the A* pathfinding algoarithm.
+ * File every zombie under the tile it stands on in 'game->zombie_grid'. Must be
+ * called whenever zombies are placed in the level, 'zombie_move()' takes care
+ * of keeping the grid up to date afterwards.
  */
-int zombie_path_search(struct npc *zombie, char level[LEVEL_H][LEVEL_W]);
+void zombie_grid_build(struct game_data *game);
+
+/* 
+ * Returns the first zombie filed under tile 'x', 'y' in 'game->zombie_grid', or
+ * -1 if there are none or the tile lies outside the level. The rest can be found
+ * by following 'game->zombie.cell_next'.
+ */
+int zombie_grid_first(struct game_data *game, int x, int y);
+
+/* 
+ * Forget about every path zombies are waiting for. Must be called whenever
+ * zombies are placed in the level.
+ */
+void zombie_queue_clear(struct game_data *game);
+
+/* 
+ * Calculate path for zombie 'i' looking for walls and other obstructions along the
+ * way in the level. Copies the path in 'ZOMBIE_PATH(i)' and returns the number of
+ * nodes. Uses the algorithm chosen in 'game->pathfinder'.
+ */
+int zombie_path_search(struct game_data *game, int i);
+
+/* 
+ * Calculate path for zombie 'i' like 'zombie_path_search()'. Zombies heading for the
+ * tile the player was last seen on share a flow field towards it rather than
+ * searching on their own.
+ */
+int zombie_path_chase(struct game_data *game, int i);
+
+/* 
+ * Start 'threads - 1' worker threads to help the main thread decide where
+ * zombies are heading in 'zombie_move()'. Zombies end up in the same places
+ * whatever the number of threads.
+ */
+void zombie_threads_init(int threads);
 
 /* 
  * Move zombies through level, chasing the player if found inside a radius of
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <time.h>
+#include <SDL.h>
+
+#include "game.h"
+#include "levels.h"
+#include "maze.h"
+#include "path.h"
+#include "zombie.h"
+
+#define BENCH_QUERIES 5000 /* Default number of random queries for each level. */
+#define BENCH_BATCH   100  /* Calls timed together for functions too quick to time alone. */
+
+/* Results for a single benchmark, summed over all levels as well. */
+struct bench_result {
+	const char *name;
+	int queries;
+	int found;
+	long expanded;
+	int num_times;
+	double *times;
+};
+
+/* Called on errors in 'levels.c', which expects 'game.c' to provide it. */
+int game_terminate(int code)
+{
+	exit(code);
+}
+
+static void bench_usage(void)
+{
+	printf(	"Usage: spooky-bench [OPTION]...\n"
+		"Options:\n"
+		" -d, --datadir\t\tDirectory where data files reside.\n"
+		" -n, --queries\t\tNumber of random queries to run for each level.\n"
+		" -h, --help\t\tDisplay this text.\n");
+	exit(1);
+}
+
+/*
+ * Returns a monotonic timestamp in microseconds.
+ */
+static double bench_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Returns the 'percent' percentile out of the 'n' timings in 'times', sorting them.
+ */
+static double bench_percentile(double *times, int n, int percent)
+{
+	if (n == 0)
+		return 0;
+
+	qsort(times, n, sizeof(double), bench_compare);
+	return times[(n - 1) * percent / 100];
+}
+
+/*
+ * Returns a random floor tile in 'game->level'.
+ */
+static struct node bench_floor(struct game_data *game)
+{
+	struct node tile;
+
+	do {
+		tile.x = rand() % game->level.w, tile.y = rand() % game->level.h;
+	} while (LEVEL_TILE(&game->level, tile.x, tile.y) != TILE_FLOOR);
+
+	return tile;
+}
+
+/*
+ * Prints 'result' for level 'label', with timings for the 'n' most recent runs,
+ * and adds them to 'total'.
+ */
+static void bench_print(const char *label, struct bench_result *result, struct bench_result *total, int n)
+{
+	double *times = result->times + result->num_times - n;
+
+	printf("%-12s %-10s %8d %8.1f%% %9.1f %9.2f %9.2f\n", label, result->name, n,
+	       100.0 * result->found / result->queries, (double) result->expanded / result->queries,
+	       bench_percentile(times, n, 50), bench_percentile(times, n, 99));
+
+	total->queries += result->queries;
+	total->found += result->found;
+	total->expanded += result->expanded;
+	result->queries = result->found = 0;
+	result->expanded = 0;
+}
+
+/*
+ * Times 'zombie_path_search()' for the first zombie in 'game' between 'queries'
+ * pairs of random floor tiles.
+ */
+static void bench_path(struct game_data *game, struct bench_result *result, struct node *query, int queries)
+{
+	int i;
+	double start;
+
+	for (i = 0; i < queries; i++) {
+		game->zombie.rect[0].x = query[i * 2].x * TILE_SIZE;
+		game->zombie.rect[0].y = query[i * 2].y * TILE_SIZE;
+		game->zombie.dest[0] = query[i * 2 + 1];
+
+		start = bench_time();
+		game->zombie.num_nodes[0] = zombie_path_search(game, 0);
+		result->times[result->num_times++] = bench_time() - start;
+
+		result->queries++;
+		result->found += (game->zombie.num_nodes[0] > 0);
+		result->expanded += path_expanded();
+	}
+}
+
+/*
+ * Times 'level_tile_visible()', or 'level_sight()' if 'lookup' is set, between
+ * random floor tiles within sight of each other.
+ */
+static void bench_visible(struct game_data *game, struct bench_result *result, int queries, bool lookup)
+{
+	int i, n, visible;
+	double start;
+	struct node src[BENCH_BATCH], dest[BENCH_BATCH];
+
+	for (i = 0; i < queries; i += BENCH_BATCH) {
+		for (n = 0; n < BENCH_BATCH; n++) {
+			src[n] = bench_floor(game);
+			do {
+				dest[n] = bench_floor(game);
+			} while (abs(dest[n].x - src[n].x) > LEVEL_SIGHT || abs(dest[n].y - src[n].y) > LEVEL_SIGHT);
+		}
+
+		start = bench_time();
+		if (lookup) {
+			for (n = 0, visible = 0; n < BENCH_BATCH; n++)
+				visible += level_sight(game, src[n].x, src[n].y, dest[n].x, dest[n].y);
+		} else {
+			for (n = 0, visible = 0; n < BENCH_BATCH; n++)
+				visible += level_tile_visible(src[n].x, src[n].y, dest[n].x, dest[n].y, &game->level);
+		}
+		result->times[result->num_times++] = (bench_time() - start) / BENCH_BATCH;
+
+		result->queries += BENCH_BATCH;
+		result->found += visible;
+	}
+}
+
+/*
+ * Times collision queries between entity rects and random tiles around them, as
+ * made by 'player_move()' with 'level_solid()' and 'level_wall()'.
+ */
+static void bench_collision(struct game_data *game, struct bench_result *result, int queries)
+{
+	int i, n, hits;
+	double start;
+	struct node tile, wall[BENCH_BATCH];
+	SDL_Rect entity[BENCH_BATCH];
+
+	for (i = 0; i < queries; i += BENCH_BATCH) {
+		for (n = 0; n < BENCH_BATCH; n++) {
+			tile = bench_floor(game);
+			entity[n].x = tile.x * TILE_SIZE + rand() % TILE_SIZE;
+			entity[n].y = tile.y * TILE_SIZE + rand() % TILE_SIZE;
+			entity[n].w = ENTITY_W, entity[n].h = ENTITY_H;
+
+			wall[n].x = tile.x + rand() % 3 - 1;
+			wall[n].y = tile.y + rand() % 3 - 1;
+		}
+
+		start = bench_time();
+		for (n = 0, hits = 0; n < BENCH_BATCH; n++)
+			hits += level_solid(game, wall[n].x, wall[n].y, SOLID_PLAYER) &&
+				level_collision(entity[n], level_wall(game, wall[n].x, wall[n].y));
+		result->times[result->num_times++] = (bench_time() - start) / BENCH_BATCH;
+
+		result->queries += BENCH_BATCH;
+		result->found += hits;
+	}
+}
+
+/*
+ * Times 'maze_generate()', counting the levels where a path leads from the
+ * entrance to the exit.
+ */
+static void bench_maze(struct game_data *game, struct bench_result *result, int runs)
+{
+	int i, y, entrance, exit;
+	double start;
+	struct level_map level = { 0 };
+	struct node path[PATH_SIZE];
+
+	level_map_init(&level, game->maze_w, game->maze_h);
+
+	for (i = 0; i < runs; i++) {
+		start = bench_time();
+		maze_generate(&level, rand());
+		result->times[result->num_times++] = bench_time() - start;
+
+		for (y = 0, entrance = exit = 0; y < level.h; y++) {
+			if (LEVEL_TILE(&level, 0, y) == TILE_DOOR)
+				entrance = y;
+			if (LEVEL_TILE(&level, level.w - 1, y) == TILE_DOOR)
+				exit = y;
+		}
+
+		result->queries++;
+		result->found += (path_search(&level, 1, entrance, level.w - 2, exit, path, PATH_SIZE) > 0);
+	}
+
+	free(level.tiles);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, n, variant, batches, queries = BENCH_QUERIES;
+	char label[32];
+	struct node *query;
+
+	static struct game_data game;
+	struct bench_result result[] = {
+		{ "astar" }, { "jps" }, { "visible" }, { "sight" }, { "collision" }, { "maze" }
+	};
+	struct bench_result total[6];
+
+	game.datadir = DATADIR;
+	game.maze_w = LEVEL_W;
+	game.maze_h = LEVEL_H;
+
+	/* Process command-line arguments. */
+	for (i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "--datadir") == 0 || strcmp(argv[i], "-d") == 0) && argv[i + 1] != NULL)
+			game.datadir = argv[++i];
+		else if ((strcmp(argv[i], "--queries") == 0 || strcmp(argv[i], "-n") == 0) && argv[i + 1] != NULL)
+			queries = atoi(argv[++i]);
+		else
+			bench_usage();
+	}
+
+	if (queries < BENCH_BATCH)
+		bench_usage();
+
+	/* Quick tests are timed in whole batches, rounding the number of calls up. */
+	batches = (queries + BENCH_BATCH - 1) / BENCH_BATCH;
+
+	/* Find our levels, from the level pack if it has been built. */
+	if (level_index(&game) == 0) {
+		fprintf(stderr, "spooky-bench: Error: Could not find levels in '%s'.\n", game.datadir);
+		exit(1);
+	}
+
+	/* Read them all in once, so that starting a level costs next to nothing. */
+	level_cache_build(&game);
+
+	/* Paths are searched for a single zombie, moved to each query in turn. */
+	game.num_zombies = 1;
+	level_entities_alloc(&game);
+
+	query = malloc(sizeof(struct node) * queries * 2);
+	for (i = 0; i < 6; i++) {
+		result[i].times = malloc(sizeof(double) * queries * game.num_levels * 4);
+		total[i] = result[i];
+	}
+
+	printf("%-12s %-10s %8s %9s %9s %9s %9s\n", "level", "test", "runs", "success", "expanded", "p50 us", "p99 us");
+
+	/* Run every benchmark on every level, as well as its mirrored and
+	 * flipped variants as picked by 'level_generate()'. */
+	for (n = 0; n < game.num_levels; n++)
+	for (variant = 0; variant < 4; variant++) {
+		level_load(&game, n, variant & 1, variant & 2);
+		snprintf(label, 32, "level-%d%s%s", n, (variant & 1) ? "m" : "", (variant & 2) ? "f" : "");
+
+		/* Pick random pairs of floor tiles, the same ones for each algorithm. */
+		srand(n * 4 + variant);
+		for (i = 0; i < queries * 2; i++)
+			query[i] = bench_floor(&game);
+
+		game.pathfinder = PATH_ASTAR;
+		bench_path(&game, &result[0], query, queries);
+		bench_print(label, &result[0], &total[0], queries);
+
+		game.pathfinder = PATH_JUMP;
+		bench_path(&game, &result[1], query, queries);
+		bench_print(label, &result[1], &total[1], queries);
+
+		/* Use the same tiles for both ways of checking visibility. */
+		srand(n * 4 + variant);
+		bench_visible(&game, &result[2], queries, false);
+		bench_print(label, &result[2], &total[2], batches);
+
+		srand(n * 4 + variant);
+		bench_visible(&game, &result[3], queries, true);
+		bench_print(label, &result[3], &total[3], batches);
+
+		bench_collision(&game, &result[4], queries);
+		bench_print(label, &result[4], &total[4], batches);
+
+		bench_maze(&game, &result[5], queries / BENCH_BATCH);
+		bench_print(label, &result[5], &total[5], queries / BENCH_BATCH);
+	}
+
+	/* Summarize over all levels. */
+	for (i = 0; i < 6; i++) {
+		total[i].times = result[i].times;
+		total[i].num_times = result[i].num_times;
+		bench_print("all", &total[i], &result[i], total[i].num_times);
+	}
+
+	return 0;
+}
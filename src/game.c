@@ -7,7 +7,9 @@
 #include "graphics.h"
 #include "input.h"
 #include "levels.h"
+#include "path.h"
 #include "player.h"
+#include "render.h"
 #include "zombie.h"
 
 int game_terminate(int code)
@@ -18,6 +20,37 @@ int game_terminate(int code)
 	exit(code);
 }
 
+/*
+ * Returns the time in milliseconds as of frame 'frame'. Without a display,
+ * frames are taken to come every 16 ms however fast they are really drawn,
+ * so that the game plays out the same way every time.
+ */
+static Uint32 game_ticks(struct game_data *game, Uint32 frame)
+{
+	if (game->render->display)
+		return SDL_GetTicks();
+
+	return frame * 16;
+}
+
+/*
+ * Reports how fast 'frames' frames were played in 'time' milliseconds, saves the
+ * last one to 'output' unless it is NULL, and exits.
+ */
+static void game_finish(struct game_data *game, Uint32 frames, Uint32 time, const char *output)
+{
+	printf("Frames: %u in %u ms (%.1f fps)\n", frames, time, time > 0 ? frames * 1000.0 / time : 0.0);
+
+	if (output != NULL && SDL_SaveBMP(game->screen, output) < 0) {
+		fprintf(stderr, "spooky-maze: Error: could not save the last frame to '%s'!\n", output);
+		SDL_Quit();
+		exit(1);
+	}
+
+	SDL_Quit();
+	exit(0);
+}
+
 static void game_usage(void)
 {
 	printf(	"Usage: spooky-maze [OPTION]...\n"
@@ -25,23 +58,37 @@ static void game_usage(void)
 		" -d, --datadir\t\tDirectory where data files reside.\n"
 		" -f, --fullscreen\tStart game in fullscreen.\n"
 		" -s, --size\t\tSize of game screen (example usage: '-s 800x600').\n"
+		" -p, --pathfinder\tAlgorithm used by zombies to find paths ('astar' or 'jps').\n"
+		" -z, --zombies\t\tNumber of zombies in each level.\n"
+		" -g, --goodies\t\tNumber of goodies to collect in each level.\n"
+		" -t, --threads\t\tNumber of threads used to move zombies.\n"
+		" -b, --budget\t\tNumber of path nodes zombies may search each frame.\n"
+		" -m, --maze\t\tPlay generated levels instead of the ones in the data directory,\n"
+		"\t\t\toptionally of the given size in tiles (example usage: '-m 120x90').\n"
+		" -r, --render\t\tHow to draw the game ('sdl', or 'buffer' or 'null' without a display).\n"
+		" -n, --frames\t\tNumber of frames to play before quitting and reporting how fast they went.\n"
+		" -o, --output\t\tFile to save the last frame to as a BMP image, along with '-n'.\n"
 		" -h, --help\t\tDisplay this text.\n");
 	exit(1);
 }
 
 int main(int argc, char *argv[])
 {
-	int i;
+	int i, n, zombies = NUM_ZOMBIES, goodies = NUM_GOODIES, threads = 1;
 	DIR *tmp_dir;
-	char *token;
-	char dirname[256];
-	bool fullscreen = false;
-	struct dirent *tmp_file;
+	char *token, *output = NULL;
+	bool fullscreen = false, fresh;
 
-	struct game_data game;
-	SDL_Surface *tmp;
+	static struct game_data game;
 	Uint32 level_time;
 	Uint32 start_time, end_time;
+	Uint32 run_time, frame = 0, frames = 0;
+
+	game.pathfinder = PATH_ASTAR;
+	game.path_queue.budget = PATH_BUDGET;
+	game.maze_w = LEVEL_W;
+	game.maze_h = LEVEL_H;
+	game.render = &render_backends[RENDER_SDL];
 
 	/* Process command-line arguments. */
 	for (i = 1; i < argc; i++) {
@@ -72,6 +119,64 @@ int main(int argc, char *argv[])
 
 			if (game.screen_w == 0 || game.screen_h == 0)
 				game_usage();
+		} else if (strcmp(argv[i], "--pathfinder") == 0 || strcmp(argv[i], "-p") == 0) {
+			if (argv[i + 1] == NULL)
+				game_usage();
+			else if (strcmp(argv[++i], "astar") == 0)
+				game.pathfinder = PATH_ASTAR;
+			else if (strcmp(argv[i], "jps") == 0)
+				game.pathfinder = PATH_JUMP;
+			else
+				game_usage();
+		} else if (strcmp(argv[i], "--zombies") == 0 || strcmp(argv[i], "-z") == 0) {
+			if (argv[i + 1] == NULL || (zombies = atoi(argv[++i])) < 0)
+				game_usage();
+		} else if (strcmp(argv[i], "--goodies") == 0 || strcmp(argv[i], "-g") == 0) {
+			if (argv[i + 1] == NULL || (goodies = atoi(argv[++i])) < 1)
+				game_usage();
+		} else if (strcmp(argv[i], "--threads") == 0 || strcmp(argv[i], "-t") == 0) {
+			if (argv[i + 1] == NULL || (threads = atoi(argv[++i])) < 1)
+				game_usage();
+		} else if (strcmp(argv[i], "--budget") == 0 || strcmp(argv[i], "-b") == 0) {
+			if (argv[i + 1] == NULL || (game.path_queue.budget = atoi(argv[++i])) < 1)
+				game_usage();
+		} else if (strcmp(argv[i], "--maze") == 0 || strcmp(argv[i], "-m") == 0) {
+			game.maze = true;
+
+			/* The size is optional, so only take the next argument if
+			 * it looks like one. */
+			if (argv[i + 1] == NULL || argv[i + 1][0] < '0' || argv[i + 1][0] > '9')
+				continue;
+
+			if ((token = strtok(argv[++i], "x")) != NULL)
+				game.maze_w = atoi(token);
+			if (token == NULL || (token = strtok(NULL, "x")) == NULL)
+				game_usage();
+
+			game.maze_h = atoi(token);
+
+			if (game.maze_w < 3 || game.maze_w > LEVEL_MAX || game.maze_h < 3 || game.maze_h > LEVEL_MAX)
+				game_usage();
+		} else if (strcmp(argv[i], "--render") == 0 || strcmp(argv[i], "-r") == 0) {
+			if (argv[i + 1] == NULL)
+				game_usage();
+
+			game.render = NULL;
+			for (++i, n = 0; n < RENDER_BACKENDS; n++) {
+				if (strcmp(argv[i], render_backends[n].name) == 0)
+					game.render = &render_backends[n];
+			}
+
+			if (game.render == NULL)
+				game_usage();
+		} else if (strcmp(argv[i], "--frames") == 0 || strcmp(argv[i], "-n") == 0) {
+			if (argv[i + 1] == NULL || (frames = atoi(argv[++i])) < 1)
+				game_usage();
+		} else if (strcmp(argv[i], "--output") == 0 || strcmp(argv[i], "-o") == 0) {
+			if (argv[i + 1] == NULL)
+				game_usage();
+
+			output = argv[++i];
 		} else {
 			game_usage();
 		}
@@ -85,35 +190,22 @@ int main(int argc, char *argv[])
 		game.screen_h = SCREEN_H;
 	}
 
-	/* Count number of levels. */
-	game.num_levels = 0;
-	snprintf(dirname, 256, "%s%s", game.datadir, "/levels/");
-
-	tmp_dir = opendir(dirname);
-	if (tmp_dir == NULL) {
-		fprintf(stderr, "spooky-maze: Error: Could not find data files in '%s'.\n", dirname);
+	/* Find our levels, from the level pack if it has been built. */
+	if (level_index(&game) == 0) {
+		fprintf(stderr, "spooky-maze: Error: Could not find levels in '%s'.\n", game.datadir);
 		game_usage();
 	}
 
-	while ((tmp_file = readdir(tmp_dir)) != NULL) {
-		if (strncmp("level-", tmp_file->d_name, 6) == 0)
-			game.num_levels++;
-	}
-
-	closedir(tmp_dir);
+	/* Read them all in once, so that starting a level costs next to nothing. */
+	level_cache_build(&game);
 
-	/* Initialize SDL and friends. */
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_TIMER) < 0) {
+	/* Initialize SDL and friends, as far as drawing the game needs them. */
+	if (SDL_Init(game.render->subsystems) < 0) {
 		fprintf(stderr, "spooky-maze: Fatal error: %s!\nExiting...\n", SDL_GetError());
 		exit(2);
 	}
 
-	if (fullscreen)
-		game.screen = SDL_SetVideoMode(game.screen_w, game.screen_h, SCREEN_DEPTH,
-			      SDL_HWSURFACE | SDL_DOUBLEBUF | SDL_FULLSCREEN);
-	else
-		game.screen = SDL_SetVideoMode(game.screen_w, game.screen_h, SCREEN_DEPTH,
-			      SDL_HWSURFACE | SDL_DOUBLEBUF);
+	game.screen = game.render->screen_init(game.screen_w, game.screen_h, fullscreen);
 
 	if (game.screen == NULL) {
 		fprintf(stderr, "spooky-maze: Fatal error: %s!\nExiting...\n", SDL_GetError());
@@ -132,17 +224,13 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	tmp = SDL_CreateRGBSurface(SDL_HWSURFACE | SDL_SRCCOLORKEY,
-				   LEVEL_W * TILE_SIZE, LEVEL_H * TILE_SIZE,
-				   SCREEN_DEPTH, 0, 0, 0, 0);
-
-	game.world = SDL_DisplayFormat(tmp);
-	SDL_FreeSurface(tmp);
-
-	SDL_WM_SetCaption("Spooky Maze", "spooky-maze");
-	SDL_ShowCursor(SDL_DISABLE);
+	/* Without a display, the same options always play out the same way. */
+	if (game.render->display)
+		srand((unsigned int) time(NULL));
+	else
+		srand(1);
 
-	srand((unsigned int) time(NULL));
+	zombie_threads_init(threads);
 
 	graphics_assets_load(&game);
 
@@ -157,6 +245,8 @@ int main(int argc, char *argv[])
 	game.brown  = SDL_MapRGB(game.screen->format, 0x77, 0x54, 0x00);
 	game.yellow = SDL_MapRGB(game.screen->format, 0xFF, 0xFA, 0x00);
 
+	run_time = SDL_GetTicks();
+
 	for (;;) {
 		game.score = 0;
 		game.cur_level = 1;
@@ -167,36 +257,39 @@ int main(int argc, char *argv[])
 		game.player.dead = false;
 
 		for (;;) {
+			fresh = game.level_cleared;
+
 			if (game.level_cleared)
-				level_generate(&game);
+				level_advance(&game);
 			else
 				level_clear(&game);
 
 			game.level_cleared = false;
 
-			game.num_zombies = 6;
-			game.num_goodies = 12;
+			game.num_zombies = zombies;
+			game.num_goodies = goodies;
 
 			level_entities_set(&game);
 			player_camera_follow(&game);
 
+			/* Drawing the level also draws the goodies, the zombies and the
+			 * player follow on the first screen update. */
 			graphics_level_draw(&game);
 
-			for (i = 0; i < game.num_goodies; i++)
-				graphics_entity_store(&(game), (struct pc *) &(game.goodie[i]));
+			/* Nothing on the screen is of any use for a new level. */
+			game.dirty.all = true;
 
-			for (i = 0; i < game.num_zombies; i++)
-				graphics_entity_store(&(game), (struct pc *) &(game.zombie[i]));
-
-			graphics_entity_store(&(game), &(game.player));
+			/* Pick the next level now, and generate it while this one is played. */
+			if (fresh)
+				level_preload(&game);
 
 			start_time = 0;
-			level_time = SDL_GetTicks();
+			level_time = game_ticks(&game, frame);
 
 			for (;;) {
-				end_time = SDL_GetTicks();
+				end_time = game_ticks(&game, frame);
 				game.delta_time =  end_time - start_time;
-				start_time = SDL_GetTicks();
+				start_time = game_ticks(&game, frame);
 
 				/* Listen to keyboard events. */
 				input_handle(&game);
@@ -224,8 +317,12 @@ int main(int argc, char *argv[])
 				/* Update and draw screen elements. */
 				graphics_screen_update(&game);
 
-				/* Try to normalize frame-rate to about 60 fps. */
-				if (game.delta_time < 16)
+				if (++frame == frames)
+					game_finish(&game, frame, SDL_GetTicks() - run_time, output);
+
+				/* Try to normalize frame-rate to about 60 fps, unless there
+				 * is no display to watch it on. */
+				if (game.render->display && game.delta_time < 16)
 					SDL_Delay(16 - game.delta_time);
 			}
 
@@ -1,108 +1,557 @@
 #include <stdio.h>
+#include <string.h>
 #include <SDL.h>
 #include <SDL_image.h>
 
 #include "game.h"
 #include "graphics.h"
 #include "levels.h"
+#include "render.h"
 
-void graphics_entity_clear(struct game_data *game, struct pc *entity)
+/*
+ * Clip 'rect' to 'area', returning false if nothing is left of it.
+ */
+static bool graphics_rect_clip(SDL_Rect *rect, SDL_Rect area)
 {
-	SDL_Rect tmp;
+	int x1 = rect->x, y1 = rect->y, x2 = rect->x + rect->w, y2 = rect->y + rect->h;
 
-	tmp.x = entity->iso_x, tmp.y = entity->iso_y;
-	tmp.w = entity->rect.w, tmp.h = entity->rect.h;
+	if (x1 < area.x)
+		x1 = area.x;
+	if (y1 < area.y)
+		y1 = area.y;
+	if (x2 > area.x + area.w)
+		x2 = area.x + area.w;
+	if (y2 > area.y + area.h)
+		y2 = area.y + area.h;
 
-	SDL_BlitSurface(entity->bg, NULL, game->world, &tmp);
+	if (x1 >= x2 || y1 >= y2)
+		return false;
+
+	rect->x = x1, rect->y = y1;
+	rect->w = x2 - x1, rect->h = y2 - y1;
+
+	return true;
 }
 
-void graphics_iso_convert(struct pc *entity)
+/*
+ * Grow 'rect' to cover 'other' as well.
+ */
+static void graphics_rect_merge(SDL_Rect *rect, SDL_Rect other)
 {
-	entity->iso_x = ((TILE_SIZE / 2) * (LEVEL_H - 1)) + ((entity->rect.x / 2) - (entity->rect.y / 2)) + ((TILE_SIZE - entity->rect.w) / 2);
-	entity->iso_y = (entity->rect.x / 4) + (entity->rect.y / 4) + ((TILE_SIZE - entity->rect.h) / 2);
+	int x1 = rect->x, y1 = rect->y, x2 = rect->x + rect->w, y2 = rect->y + rect->h;
+
+	if (x1 > other.x)
+		x1 = other.x;
+	if (y1 > other.y)
+		y1 = other.y;
+	if (x2 < other.x + other.w)
+		x2 = other.x + other.w;
+	if (y2 < other.y + other.h)
+		y2 = other.y + other.h;
+
+	rect->x = x1, rect->y = y1;
+	rect->w = x2 - x1, rect->h = y2 - y1;
 }
 
-void graphics_entity_draw(struct game_data *game, const int entity_type, struct pc *entity)
+struct iso graphics_iso_convert(struct game_data *game, SDL_Rect rect)
 {
-	SDL_Rect tmp, offset;
+	struct iso iso;
 
-	tmp.x = entity->iso_x, tmp.y = entity->iso_y;
-	tmp.w = entity->rect.w, tmp.h = entity->rect.h;
+	iso.x = ((TILE_SIZE / 2) * (game->level.h - 1)) + ((rect.x / 2) - (rect.y / 2)) + ((TILE_SIZE - rect.w) / 2);
+	iso.y = (rect.x / 4) + (rect.y / 4) + ((TILE_SIZE - rect.h) / 2);
 
-	/* Animation offset within the sprite. */
-	offset.x = 0, offset.y = 0;
-	offset.w = entity->rect.w, offset.h = entity->rect.h;
+	return iso;
+}
 
-	/* Draw entity. */
-	switch (entity_type) {
-		case ENTITY_PLAYER:
-			SDL_BlitSurface(game->graphics.player, &offset, game->world, &tmp);
-			break;
-		case ENTITY_ZOMBIE:
-			SDL_BlitSurface(game->graphics.zombie, &offset, game->world, &tmp);
-			break;
-		case ENTITY_GOODIE:
-			SDL_BlitSurface(game->graphics.goodie, &offset, game->world, &tmp);
-			break;
+/*
+ * Returns true if 'w' by 'h' pixels at 'iso' on the world come within
+ * 'CAMERA_MARGIN' of the camera.
+ */
+static bool graphics_in_view(struct game_data *game, struct iso iso, int w, int h)
+{
+	return iso.x < game->camera.x + game->camera.w + CAMERA_MARGIN && iso.x + w > game->camera.x - CAMERA_MARGIN &&
+	       iso.y < game->camera.y + game->camera.h + CAMERA_MARGIN && iso.y + h > game->camera.y - CAMERA_MARGIN;
+}
+
+void graphics_dirty_add(struct game_data *game, struct iso iso, int w, int h)
+{
+	SDL_Rect rect;
+
+	rect.x = iso.x, rect.y = iso.y;
+	rect.w = w, rect.h = h;
+
+	/* The world has to be drawn again wherever something changed, in view or
+	 * not, so nothing is dropped. Past a point it's cheaper to draw one large
+	 * rect than to keep track, so the last rect grows to cover the rest. */
+	if (game->dirty.num_rects == DIRTY_MAX)
+		graphics_rect_merge(&game->dirty.rect[DIRTY_MAX - 1], rect);
+	else
+		game->dirty.rect[game->dirty.num_rects++] = rect;
+}
+
+/*
+ * Adds 'image' at 'iso' on the world to the sprites drawn this frame if it
+ * comes into view, with 'rect' where it is on the level. '*drawn' and '*shown'
+ * tell whether and where it was drawn last frame, and are brought up to date,
+ * marking where it left and where it came to as dirty.
+ */
+static void graphics_sprite_add(struct game_data *game, SDL_Surface *image, SDL_Rect rect, struct iso iso, bool *drawn, struct iso *shown)
+{
+	struct sprite *sprite;
+	bool in_view = graphics_in_view(game, iso, rect.w, rect.h);
+	bool moved = iso.x != shown->x || iso.y != shown->y;
+
+	if (*drawn && (moved || !in_view))
+		graphics_dirty_add(game, *shown, rect.w, rect.h);
+	if (in_view && (moved || !*drawn))
+		graphics_dirty_add(game, iso, rect.w, rect.h);
+
+	*drawn = in_view, *shown = iso;
+	if (!in_view)
+		return;
+
+	sprite = &game->sprites.sprite[game->sprites.num_sprites++];
+	sprite->rect.x = iso.x, sprite->rect.y = iso.y;
+	sprite->rect.w = rect.w, sprite->rect.h = rect.h;
+	sprite->image = image;
+
+	/* Further right and down on the level is nearer the front. */
+	sprite->depth = rect.x + rect.y;
+}
+
+/*
+ * Sorts the sprites back to front, keeping sprites of the same depth in the
+ * order they were added. A radix sort, going over the depth a byte at a time,
+ * takes a fixed number of passes however many sprites there are.
+ */
+static void graphics_sprites_sort(struct game_data *game)
+{
+	int i, shift, count[256 + 1];
+	struct sprites *sprites = &game->sprites;
+	struct sprite *tmp;
+
+	for (shift = 0; shift < 16; shift += 8) {
+		memset(count, 0, sizeof(count));
+
+		for (i = 0; i < sprites->num_sprites; i++)
+			count[((sprites->sprite[i].depth >> shift) & 0xff) + 1]++;
+
+		/* Where the sprites of each byte value start in 'sorted'. */
+		for (i = 1; i <= 256; i++)
+			count[i] += count[i - 1];
+
+		for (i = 0; i < sprites->num_sprites; i++)
+			sprites->sorted[count[(sprites->sprite[i].depth >> shift) & 0xff]++] = sprites->sprite[i];
+
+		tmp = sprites->sprite;
+		sprites->sprite = sprites->sorted;
+		sprites->sorted = tmp;
 	}
 }
 
+/*
+ * Collects the zombies and the player near the camera into 'game->sprites',
+ * sorted back to front, marking the ones that moved, came into view or left
+ * it as dirty.
+ */
+static void graphics_sprites_collect(struct game_data *game)
+{
+	int i, size;
+	struct sprites *sprites = &game->sprites;
+
+	if (game->num_zombies + 1 > sprites->size) {
+		size = sprites->size * 2;
+		if (size < game->num_zombies + 1)
+			size = game->num_zombies + 1;
+
+		sprites->sprite = realloc(sprites->sprite, sizeof(struct sprite) * size);
+		sprites->sorted = realloc(sprites->sorted, sizeof(struct sprite) * size);
+
+		if (sprites->sprite == NULL || sprites->sorted == NULL) {
+			printf("Error: Out of memory for sprites!\nExiting...\n");
+			game_terminate(0);
+		}
+
+		sprites->size = size;
+	}
+
+	sprites->num_sprites = 0;
+
+	for (i = 0; i < game->num_zombies; i++)
+		graphics_sprite_add(game, game->graphics.zombie, game->zombie.rect[i], game->zombie.iso[i],
+				&game->zombie.drawn[i], &game->zombie.shown[i]);
+
+	/* Added last, so that it stays in front of zombies at the same depth. */
+	graphics_sprite_add(game, game->graphics.player, game->player.rect, game->player.iso,
+			&game->player.drawn, &game->player.shown);
+
+	graphics_sprites_sort(game);
+}
+
+/*
+ * Sets 'x1', 'y1' to the first chunk 'rect' of the world lies on, and 'x2', 'y2'
+ * to the last one. Returns false if it lies off the world altogether.
+ */
+static bool graphics_world_chunks(struct game_data *game, SDL_Rect rect, int *x1, int *y1, int *x2, int *y2)
+{
+	if (rect.x + rect.w <= 0 || rect.y + rect.h <= 0 || rect.w == 0 || rect.h == 0)
+		return false;
+
+	*x1 = rect.x > 0 ? rect.x / WORLD_CHUNK : 0;
+	*y1 = rect.y > 0 ? rect.y / WORLD_CHUNK : 0;
+	*x2 = (rect.x + rect.w - 1) / WORLD_CHUNK;
+	*y2 = (rect.y + rect.h - 1) / WORLD_CHUNK;
+
+	if (*x1 >= game->world.chunks_w || *y1 >= game->world.chunks_h)
+		return false;
+
+	if (*x2 >= game->world.chunks_w)
+		*x2 = game->world.chunks_w - 1;
+	if (*y2 >= game->world.chunks_h)
+		*y2 = game->world.chunks_h - 1;
+
+	return true;
+}
+
+void graphics_world_blit(struct game_data *game, SDL_Rect rect, SDL_Surface *surface, int x, int y, bool to_world)
+{
+	int cx, cy, x1, y1, x2, y2, slot;
+	int left, top, right, bottom;
+	SDL_Rect src, dst;
+
+	if (!graphics_world_chunks(game, rect, &x1, &y1, &x2, &y2))
+		return;
+
+	for (cy = y1; cy <= y2; cy++)
+		for (cx = x1; cx <= x2; cx++) {
+			slot = game->world.chunk[cy * game->world.chunks_w + cx];
+			if (slot == -1)
+				continue;
+
+			/* Part of 'rect' that lies on this chunk. */
+			left = rect.x > cx * WORLD_CHUNK ? rect.x : cx * WORLD_CHUNK;
+			top = rect.y > cy * WORLD_CHUNK ? rect.y : cy * WORLD_CHUNK;
+			right = rect.x + rect.w < (cx + 1) * WORLD_CHUNK ? rect.x + rect.w : (cx + 1) * WORLD_CHUNK;
+			bottom = rect.y + rect.h < (cy + 1) * WORLD_CHUNK ? rect.y + rect.h : (cy + 1) * WORLD_CHUNK;
+
+			src.x = left - cx * WORLD_CHUNK, src.y = top - cy * WORLD_CHUNK;
+			src.w = right - left, src.h = bottom - top;
+			dst.x = x + (left - rect.x), dst.y = y + (top - rect.y);
+			dst.w = src.w, dst.h = src.h;
+
+			if (to_world)
+				game->render->copy(surface, &dst, game->world.slot[slot].surface, &src);
+			else
+				game->render->copy(game->world.slot[slot].surface, &src, surface, &dst);
+		}
+}
+
+/*
+ * Returns 'a' divided by 'b', rounded down even when 'a' is negative.
+ */
+static int graphics_div_floor(int a, int b)
+{
+	return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+/*
+ * Sets 'x1' and 'x2' to the first and last tile in row 'y' of 'level' whose
+ * isometric view reaches into 'area' of the world, with 'x1' past 'x2' if
+ * none do.
+ */
+static void graphics_tile_span(const struct level_map *level, SDL_Rect area, int y, int *x1, int *x2)
+{
+	int lo, hi, left = (TILE_SIZE / 2) * (level->h - (1 + y));
+
+	/* Tile 'x' lies half a tile further right than the one before it, ... */
+	*x1 = graphics_div_floor(area.x - TILE_SIZE - left, TILE_SIZE / 2) + 1;
+	*x2 = graphics_div_floor(area.x + area.w - 1 - left, TILE_SIZE / 2);
+
+	/* ... and a quarter of a tile further down. */
+	lo = graphics_div_floor(area.y - TILE_SIZE, TILE_SIZE / 4) + 1 - y;
+	hi = graphics_div_floor(area.y + area.h - 1, TILE_SIZE / 4) - y;
+
+	if (*x1 < lo)
+		*x1 = lo;
+	if (*x1 < 0)
+		*x1 = 0;
+	if (*x2 > hi)
+		*x2 = hi;
+	if (*x2 > level->w - 1)
+		*x2 = level->w - 1;
+}
+
+/*
+ * Draws the part of 'image' at 'rect' of the world that lies in 'area' to
+ * 'surface', where the top left corner of 'area' is at 'pos_x', 'pos_y'.
+ */
+static void graphics_part_draw(struct game_data *game, SDL_Surface *surface, SDL_Surface *image, SDL_Rect rect, SDL_Rect area, int pos_x, int pos_y)
+{
+	SDL_Rect src = rect, dst;
+
+	if (!graphics_rect_clip(&src, area))
+		return;
+
+	dst.x = pos_x + (src.x - area.x), dst.y = pos_y + (src.y - area.y);
+	dst.w = src.w, dst.h = src.h;
+	src.x -= rect.x, src.y -= rect.y;
+
+	game->render->sprite_draw(image, &src, surface, &dst);
+}
+
+/*
+ * Draws 'area' of the world to 'surface', with its top left corner at 'pos_x',
+ * 'pos_y': the level, the goodies lying on it and the sprites over them.
+ */
+static void graphics_world_render(struct game_data *game, SDL_Surface *surface, SDL_Rect area, int pos_x, int pos_y)
+{
+	int i, x, y, x1, x2;
+	SDL_Rect clip, near, rect;
+
+	clip.x = pos_x, clip.y = pos_y;
+	clip.w = area.w, clip.h = area.h;
+
+	game->render->level_fill(surface, &clip, game->black);
+	graphics_level_render(game, surface, &game->level, area, pos_x, pos_y);
+
+	/* Goodies stick out less than a quarter of a tile past the view of the
+	 * tile they are filed under. */
+	near.x = area.x - TILE_SIZE / 4, near.y = area.y - TILE_SIZE / 4;
+	near.w = area.w + TILE_SIZE / 2, near.h = area.h + TILE_SIZE / 2;
+
+	for (y = 0; y < game->level.h; y++) {
+		graphics_tile_span(&game->level, near, y, &x1, &x2);
+
+		for (x = x1; x <= x2; x++) {
+			for (i = level_goodie_first(game, x, y); i != -1; i = game->goodie.cell_next[i]) {
+				rect.x = game->goodie.iso[i].x, rect.y = game->goodie.iso[i].y;
+				rect.w = game->goodie.rect[i].w, rect.h = game->goodie.rect[i].h;
+
+				graphics_part_draw(game, surface, game->graphics.goodie, rect, area, pos_x, pos_y);
+			}
+		}
+	}
+
+	for (i = 0; i < game->sprites.num_sprites; i++)
+		graphics_part_draw(game, surface, game->sprites.sprite[i].image, game->sprites.sprite[i].rect, area, pos_x, pos_y);
+}
+
+/*
+ * Draws 'rect' of the world again on the chunks that are kept.
+ */
+static void graphics_world_repair(struct game_data *game, SDL_Rect rect)
+{
+	int cx, cy, x1, y1, x2, y2, slot;
+	SDL_Rect part, chunk;
+
+	if (!graphics_world_chunks(game, rect, &x1, &y1, &x2, &y2))
+		return;
+
+	chunk.w = chunk.h = WORLD_CHUNK;
+
+	for (cy = y1; cy <= y2; cy++)
+		for (cx = x1; cx <= x2; cx++) {
+			slot = game->world.chunk[cy * game->world.chunks_w + cx];
+			if (slot == -1)
+				continue;
+
+			chunk.x = cx * WORLD_CHUNK, chunk.y = cy * WORLD_CHUNK;
+			part = rect;
+
+			if (graphics_rect_clip(&part, chunk))
+				graphics_world_render(game, game->world.slot[slot].surface, part, part.x - chunk.x, part.y - chunk.y);
+		}
+}
+
+/*
+ * Draws chunk 'chunk' of the world, in place of the chunk that has been out of
+ * view the longest.
+ */
+static void graphics_chunk_load(struct game_data *game, int chunk)
+{
+	int i, slot = 0;
+	SDL_Rect rect;
+	struct world *world = &game->world;
+
+	/* Slots that were never used count as out of view the longest. */
+	for (i = 1; i < world->size; i++) {
+		if (world->slot[i].used < world->slot[slot].used)
+			slot = i;
+	}
+
+	if (world->slot[slot].chunk != -1)
+		world->chunk[world->slot[slot].chunk] = -1;
+
+	if (world->slot[slot].surface == NULL)
+		world->slot[slot].surface = graphics_surface_init(game, WORLD_CHUNK, WORLD_CHUNK);
+
+	world->slot[slot].chunk = chunk;
+	world->slot[slot].used = world->view;
+	world->chunk[chunk] = slot;
+
+	rect.x = (chunk % world->chunks_w) * WORLD_CHUNK;
+	rect.y = (chunk / world->chunks_w) * WORLD_CHUNK;
+	rect.w = rect.h = WORLD_CHUNK;
+
+	graphics_world_render(game, world->slot[slot].surface, rect, 0, 0);
+}
+
+void graphics_world_view(struct game_data *game)
+{
+	int x, y, x1, y1, x2, y2, slot;
+	struct world *world = &game->world;
+
+	world->view++;
+
+	if (!graphics_world_chunks(game, game->camera, &x1, &y1, &x2, &y2))
+		return;
+
+	/* Mark the chunks that are already there as in view first, so that none
+	 * of them makes room for the ones that aren't. */
+	for (y = y1; y <= y2; y++)
+		for (x = x1; x <= x2; x++) {
+			slot = world->chunk[y * world->chunks_w + x];
+			if (slot != -1)
+				world->slot[slot].used = world->view;
+		}
+
+	for (y = y1; y <= y2; y++)
+		for (x = x1; x <= x2; x++) {
+			if (world->chunk[y * world->chunks_w + x] == -1)
+				graphics_chunk_load(game, y * world->chunks_w + x);
+		}
+}
+
 void graphics_level_draw(struct game_data *game)
 {
-	int x, y;
-	SDL_Rect tile;
+	int i;
+	struct world *world = &game->world;
+
+	/* Room for the isometric view of every tile, with the bottom corner of
+	 * the last tile sticking out half a tile below, as well as for the doors,
+	 * which are filled in where they are on the level itself. */
+	world->w = (game->level.w + game->level.h) * (TILE_SIZE / 2);
+	world->h = (game->level.w + game->level.h) * (TILE_SIZE / 4) + (TILE_SIZE / 2);
+
+	if (world->w < game->level.w * TILE_SIZE)
+		world->w = game->level.w * TILE_SIZE;
+	if (world->h < game->level.h * TILE_SIZE)
+		world->h = game->level.h * TILE_SIZE;
+
+	world->chunks_w = (world->w + WORLD_CHUNK - 1) / WORLD_CHUNK;
+	world->chunks_h = (world->h + WORLD_CHUNK - 1) / WORLD_CHUNK;
+
+	/* Enough chunks to cover the screen twice over, however it lies on them,
+	 * so that going back and forth doesn't keep drawing the same ones. */
+	if (world->slot == NULL) {
+		world->size = 2 * (game->screen_w / WORLD_CHUNK + 2) * (game->screen_h / WORLD_CHUNK + 2);
+		world->slot = calloc(world->size, sizeof(struct world_slot));
+	}
 
-	tile.w = tile.h = TILE_SIZE;
+	world->chunk = realloc(world->chunk, sizeof(int) * world->chunks_w * world->chunks_h);
 
-	for (y = 0; y < LEVEL_H; y++) {
-		tile.x = (tile.w / 2) * (LEVEL_H - (1 + y));
-		tile.y = (tile.h / 4) * y;
+	if (world->slot == NULL || world->chunk == NULL) {
+		printf("Error: Out of memory for the world!\nExiting...\n");
+		game_terminate(0);
+	}
 
-		for (x = 0; x < LEVEL_W; x++) {
-			switch (game->level[y][x]) {
-			case TILE_WALL:
-				game->wall[y][x].w = TILE_SIZE;
-				game->wall[y][x].h = TILE_SIZE;
-				game->wall[y][x].x = x * TILE_SIZE;
-				game->wall[y][x].y = y * TILE_SIZE;
+	for (i = 0; i < world->chunks_w * world->chunks_h; i++)
+		world->chunk[i] = -1;
 
-				graphics_tile_draw(game, TILE_WALL, tile);
-				break;
-			case TILE_DOOR: /* Behaves like a wall for collision purposes. */
-				game->wall[y][x].w = TILE_SIZE;
-				game->wall[y][x].h = TILE_SIZE;
-				game->wall[y][x].x = x * TILE_SIZE;
-				game->wall[y][x].y = y * TILE_SIZE;
+	for (i = 0; i < world->size; i++)
+		world->slot[i].chunk = -1, world->slot[i].used = 0;
+
+	/* Sprites are drawn to the new level from the first screen update on. */
+	for (i = 0; i < game->num_zombies; i++)
+		game->zombie.drawn[i] = false;
+
+	game->player.drawn = false;
+	game->sprites.num_sprites = 0;
+
+	world->view = 0;
+
+	graphics_world_view(game);
+}
+
+void graphics_level_render(struct game_data *game, SDL_Surface *surface, const struct level_map *level, SDL_Rect area, int pos_x, int pos_y)
+{
+	int x, y, x1, x2, first, last, door_x1, door_x2;
+	bool doors;
+	SDL_Rect tile, door, clip;
+
+	tile.w = tile.h = TILE_SIZE;
+
+	/* Tiles reaching out of 'area' are cut off at its edges. */
+	clip.x = pos_x, clip.y = pos_y;
+	clip.w = area.w, clip.h = area.h;
+	SDL_SetClipRect(surface, &clip);
+
+	/* Doors are filled in where they are on the level itself, so in rows of
+	 * 'area' they are looked for in the columns of 'area' instead. */
+	door_x1 = area.x > 0 ? area.x / TILE_SIZE : 0;
+	door_x2 = (area.x + area.w - 1) / TILE_SIZE;
+
+	for (y = 0; y < level->h; y++) {
+		graphics_tile_span(level, area, y, &x1, &x2);
+		first = x1, last = x2;
+
+		doors = y * TILE_SIZE < area.y + area.h && (y + 1) * TILE_SIZE > area.y;
+		if (doors && door_x1 < first)
+			first = door_x1;
+		if (doors && door_x2 > last)
+			last = door_x2 < level->w - 1 ? door_x2 : level->w - 1;
+
+		for (x = first; x <= last; x++) {
+			tile.x = (TILE_SIZE / 2) * (level->h - (1 + y) + x) - area.x + pos_x;
+			tile.y = (TILE_SIZE / 4) * (y + x) - area.y + pos_y;
+
+			switch (LEVEL_TILE(level, x, y)) {
+			case TILE_DOOR: /* Only the right half blocks, see 'level_wall()'. */
+			case TILE_EXIT: /* Still shown as the door it was drawn as. */
+				if (!doors || x < door_x1 || x > door_x2)
+					continue;
+
+				door.w = TILE_SIZE;
+				door.h = TILE_SIZE;
+				door.x = x * TILE_SIZE - area.x + pos_x;
+				door.y = y * TILE_SIZE - area.y + pos_y;
 
 				/* Set floor tile for the one half. */
-				SDL_FillRect(game->world, &(game->wall[y][x]), game->black);
+				game->render->level_fill(surface, &door, game->black);
 
 				/* The other half is a door. */
-				game->wall[y][x].w = TILE_SIZE / 2;
-				game->wall[y][x].x = x * TILE_SIZE + (TILE_SIZE / 2);
+				door.w = TILE_SIZE / 2;
+				door.x = x * TILE_SIZE + (TILE_SIZE / 2) - area.x + pos_x;
 
-				SDL_FillRect(game->world, &(game->wall[y][x]), game->brown);
+				game->render->level_fill(surface, &door, game->brown);
+				continue;
+			}
+
+			/* Leave out tiles that don't reach into 'area'. */
+			if (x < x1 || x > x2)
+				continue;
+
+			switch (LEVEL_TILE(level, x, y)) {
+			case TILE_WALL:
+				graphics_tile_draw(game, surface, TILE_WALL, tile);
 				break;
 			case TILE_GOODIE: /* Goodies should always have floor tiles under them. */
 			case TILE_UNWALKABLE: /* This tile is unwalkable by zombies. */
 			case TILE_FLOOR:
 			default:
-				game->wall[y][x].w = TILE_SIZE;
-				game->wall[y][x].h = TILE_SIZE;
-				game->wall[y][x].x = x * TILE_SIZE;
-				game->wall[y][x].y = y * TILE_SIZE;
-
-				graphics_tile_draw(game, TILE_FLOOR, tile);
+				graphics_tile_draw(game, surface, TILE_FLOOR, tile);
 				break;
 			}
-
-			tile.x += tile.w / 2;
-			tile.y += tile.h / 4;
 		}
 	}
+
+	SDL_SetClipRect(surface, NULL);
 }
 
-void graphics_text_draw(struct game_data *game, const char *text, int pos_x, int pos_y)
+/*
+ * Draws 'text' on 'surface' one glyph at a time, see 'graphics_text_draw()'.
+ */
+static void graphics_glyphs_draw(struct game_data *game, const char *text, SDL_Surface *surface, int pos_x, int pos_y)
 {
 	int i;
 	SDL_Rect font, offset;
@@ -115,12 +564,17 @@ void graphics_text_draw(struct game_data *game, const char *text, int pos_x, int
 		font.x = (text[i] % 10) * font.w;
 		font.y = ((text[i] / 10) - 3) * font.h;
 
-		SDL_BlitSurface(game->graphics.font, &font, game->screen, &offset);
+		game->render->text_draw(game->graphics.font, &font, surface, &offset);
 		offset.x += font.w;
 	}
 }
 
-void graphics_tile_draw(struct game_data *game, const int tile_type, SDL_Rect tile)
+void graphics_text_draw(struct game_data *game, const char *text, int pos_x, int pos_y)
+{
+	graphics_glyphs_draw(game, text, game->screen, pos_x, pos_y);
+}
+
+void graphics_tile_draw(struct game_data *game, SDL_Surface *world, const int tile_type, SDL_Rect tile)
 {
 	SDL_Rect offset;
 
@@ -136,24 +590,18 @@ void graphics_tile_draw(struct game_data *game, const int tile_type, SDL_Rect ti
 			break;
 	}
 
-	SDL_BlitSurface(game->graphics.level, &offset, game->world, &tile);
+	game->render->level_draw(game->graphics.level, &offset, world, &tile);
 }
 
-SDL_Surface *graphics_surface_init(int width, int height)
+SDL_Surface *graphics_surface_init(struct game_data *game, int width, int height)
 {
-	SDL_Surface *tmp, *optimized;
+	SDL_Surface *optimized;
 
-	/* Initialize temporary surface. */
-	tmp = SDL_CreateRGBSurface(SDL_HWSURFACE | SDL_SRCCOLORKEY,
-			  width, height, SCREEN_DEPTH, 0, 0, 0, 0);
-
-	/* Optimize surface for rendering. */
-	optimized = SDL_DisplayFormat(tmp);
+	/* Initialize surface, optimized for rendering. */
+	optimized = game->render->surface_init(width, height);
 	if (optimized == NULL) {
 		printf("Error: Initialization of surface failed!\nExiting...\n");
 		game_terminate(0);
-	} else {
-		SDL_FreeSurface(tmp);
 	}
 
 	return optimized;
@@ -166,30 +614,30 @@ void graphics_assets_load(struct game_data *game)
 	/* Load font for menus etc. */
 	if (game->screen_h <= 320) {
 		snprintf(tmp_file, 256, "%s%s", game->datadir, "/graphics/font-320.png");
-		game->graphics.font = graphics_image_load(tmp_file);
+		game->graphics.font = graphics_image_load(game, tmp_file);
 	} else {
 		snprintf(tmp_file, 256, "%s%s", game->datadir, "/graphics/font-640.png");
-		game->graphics.font = graphics_image_load(tmp_file);
+		game->graphics.font = graphics_image_load(game, tmp_file);
 	}
 
 	/* Load tileset for use in levels. */
 	snprintf(tmp_file, 256, "%s%s", game->datadir, "/graphics/level.png");
-	game->graphics.level = graphics_image_load(tmp_file);
+	game->graphics.level = graphics_image_load(game, tmp_file);
 
 	/* Load sprites for player. */
 	snprintf(tmp_file, 256, "%s%s", game->datadir, "/graphics/player.png");
-	game->graphics.player = graphics_image_load(tmp_file);
+	game->graphics.player = graphics_image_load(game, tmp_file);
 
 	/* Load sprites for zombies. */
 	snprintf(tmp_file, 256, "%s%s", game->datadir, "/graphics/zombie.png");
-	game->graphics.zombie = graphics_image_load(tmp_file);
+	game->graphics.zombie = graphics_image_load(game, tmp_file);
 
 	/* Load sprites for goodies. */
 	snprintf(tmp_file, 256, "%s%s", game->datadir, "/graphics/goodie.png");
-	game->graphics.goodie = graphics_image_load(tmp_file);
+	game->graphics.goodie = graphics_image_load(game, tmp_file);
 }
 
-SDL_Surface *graphics_image_load(const char *filename)
+SDL_Surface *graphics_image_load(struct game_data *game, const char *filename)
 {
 	SDL_Surface *tmp, *image;
 
@@ -200,99 +648,265 @@ SDL_Surface *graphics_image_load(const char *filename)
 		game_terminate(0);
 	}
 
-	/* Optimize image and set alpha channel. */
-	image = SDL_DisplayFormatAlpha(tmp);
+	/* Optimize image, keeping its alpha channel. */
+	image = game->render->image_convert(tmp);
 	if (image == NULL) {
 		printf("Error: Conversion of image file failed!\nExiting...\n");
 		game_terminate(0);
 	} else {
-		SDL_SetColorKey(image, SDL_RLEACCEL, image->format->colorkey);
 		SDL_FreeSurface(tmp);
 	}
 
 	return image;
 }
 
-void graphics_entity_store(struct game_data *game, struct pc *entity)
+/*
+ * Clip 'rect' to the screen, returning false if nothing is left of it.
+ */
+static bool graphics_screen_clip(struct game_data *game, SDL_Rect *rect)
+{
+	SDL_Rect screen;
+
+	screen.x = 0, screen.y = 0;
+	screen.w = game->screen_w, screen.h = game->screen_h;
+
+	return graphics_rect_clip(rect, screen);
+}
+
+/*
+ * Returns true if 'a' and 'b' share any pixels.
+ */
+static bool graphics_rect_overlap(SDL_Rect a, SDL_Rect b)
+{
+	return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+/* Info text shown on top of the level, see 'graphics_text_update()'. */
+#define GRAPHICS_TEXTS 4
+
+static struct graphics_text {
+	char text[32];
+	SDL_Surface *surface;	/* 'text' drawn once, kept for as long as it fits. */
+	SDL_Rect rect;		/* Where the text goes on the screen. */
+	SDL_Rect shown;		/* Where it was drawn last, and has to be cleared from. */
+	bool changed;		/* Has to be drawn again. */
+} graphics_text[GRAPHICS_TEXTS];
+
+/*
+ * Set info text 'i' to 'text', with its top left corner at 'pos_x', 'pos_y' on
+ * the screen, or its top center if 'center' is set, and draw it to its surface.
+ */
+static void graphics_text_set(struct game_data *game, int i, const char *text, int pos_x, int pos_y, bool center)
 {
-	SDL_Rect tmp;
+	struct graphics_text *info = &graphics_text[i];
+	SDL_PixelFormat *format = game->graphics.font->format;
+
+	snprintf(info->text, sizeof(info->text), "%s", text);
+
+	info->rect.w = (game->graphics.font->w / 10) * strlen(info->text);
+	info->rect.h = game->graphics.font->h / 10;
+	info->rect.x = center ? pos_x - info->rect.w / 2 : pos_x;
+	info->rect.y = pos_y;
+	info->changed = true;
+
+	/* Room for the longest text there can be, so that it's only made once. */
+	if (info->surface == NULL) {
+		info->surface = SDL_CreateRGBSurface(SDL_SWSURFACE | SDL_SRCALPHA,
+				(game->graphics.font->w / 10) * (sizeof(info->text) - 1), info->rect.h,
+				format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+
+		if (info->surface == NULL) {
+			printf("Error: Initialization of surface failed!\nExiting...\n");
+			game_terminate(0);
+		}
+	}
+
+	/* Copy the glyphs over as they are, alpha and all, so that the text blends
+	 * in the same way as if each glyph was drawn to the screen by itself. */
+	SDL_FillRect(info->surface, NULL, SDL_MapRGBA(info->surface->format, 0, 0, 0, 0));
+	SDL_SetAlpha(game->graphics.font, 0, SDL_ALPHA_OPAQUE);
+	graphics_glyphs_draw(game, info->text, info->surface, 0, 0);
+	SDL_SetAlpha(game->graphics.font, SDL_SRCALPHA, SDL_ALPHA_OPAQUE);
+}
+
+/*
+ * Draws info text 'i' to the screen, where it goes.
+ */
+static void graphics_text_show(struct game_data *game, int i)
+{
+	struct graphics_text *info = &graphics_text[i];
+	SDL_Rect src, dst;
 
-	tmp.x = entity->iso_x, tmp.y = entity->iso_y;
-	tmp.w = entity->rect.w, tmp.h = entity->rect.h;
+	src.x = 0, src.y = 0;
+	src.w = info->rect.w, src.h = info->rect.h;
+	dst = info->rect;
 
-	SDL_BlitSurface(game->world, &tmp, entity->bg, NULL);
+	game->render->text_draw(info->surface, &src, game->screen, &dst);
+
+	info->shown = info->rect;
+	info->changed = false;
 }
 
 void graphics_text_update(struct game_data *game)
 {
-	static int goodies, lives, score = 1, time;
-	static char goodies_text[16], lives_text[16], score_text[32], time_text[16];
+	static int goodies = -1, lives = -1, score = -1, time = -1;
+	char text[32];
 
 	/* Bottom center: Number of goodies remaining. */
 	if (goodies != game->num_goodies) {
 		goodies = game->num_goodies;
 		if (goodies == 0)
-			snprintf(goodies_text, 16, "%s", "Door open!");
+			snprintf(text, sizeof(text), "%s", "Door open!");
 		else
-			snprintf(goodies_text, 16, "%s%d", "Goodies:", game->num_goodies);
-	}
+			snprintf(text, sizeof(text), "%s%d", "Goodies:", game->num_goodies);
 
-	graphics_text_draw(game, goodies_text, (game->screen_w / 2) - (((game->graphics.font->w / 10) * strlen(goodies_text)) / 2), game->screen_h - 40);
+		graphics_text_set(game, 0, text, game->screen_w / 2, game->screen_h - 40, true);
+	}
 
 	/* Top left: Number of lives remaining. */
 	if (lives != game->player.lives) {
 		lives = game->player.lives;
-		snprintf(lives_text, 16, "%s%d", "Lives:", game->player.lives);
-	}
+		snprintf(text, sizeof(text), "%s%d", "Lives:", game->player.lives);
 
-	graphics_text_draw(game, lives_text, game->screen_w - ((game->graphics.font->w / 10) * strlen(lives_text)) - 5 , 5);
+		graphics_text_set(game, 1, text, game->screen_w - ((game->graphics.font->w / 10) * strlen(text)) - 5, 5, false);
+	}
 
 	/* Top Right: Current score. */
 	if (score != game->score) {
 		score = game->score;
-		snprintf(score_text, 16, "%s%d", "Score:", game->score);
-	}
+		snprintf(text, sizeof(text), "%s%d", "Score:", game->score);
 
-	graphics_text_draw(game, score_text, 5 , 5);
+		graphics_text_set(game, 2, text, 5, 5, false);
+	}
 
 	/* Top center: Time remaining. */
 	if (time != game->time) {
 		time = game->time;
-		snprintf(time_text, 16, "%s%d", "Time:", game->time);
-	}
+		snprintf(text, sizeof(text), "%s%d", "Time:", game->time);
 
-	graphics_text_draw(game, time_text, (game->screen_w / 2) - (((game->graphics.font->w / 10) * strlen(time_text)) / 2), 5);
+		graphics_text_set(game, 3, text, game->screen_w / 2, 5, true);
+	}
 }
 
 void graphics_screen_update(struct game_data *game)
 {
-	int i;
+	int i, n, dx, dy, num_rects = 0;
+	bool added, drawn[GRAPHICS_TEXTS];
+	SDL_Rect src, dst, rect[DIRTY_MAX + 2 + GRAPHICS_TEXTS * 2];
 
-	/* Clear entities from screen. */
-	for (i = 0; i < game->num_goodies; i++)
-		graphics_entity_clear(game, (struct pc *) &(game->goodie[i]));
+	/* Sort the sprites near the camera, marking where they moved, ... */
+	graphics_sprites_collect(game);
 
-	/* Store entity backgrounds for next time we clear. */
-	for (i = 0; i < game->num_zombies; i++)
-		graphics_entity_store(game, (struct pc *) &(game->zombie[i]));
+	/* ... draw the parts of the world that came into view with them, ... */
+	graphics_world_view(game);
 
-	if (game->player.dir_x != 0 || game->player.dir_y != 0)
-		graphics_entity_store(game, &(game->player));
+	/* ... and draw the world again from the level up wherever it changed,
+	 * which leaves no trace of where sprites were. */
+	for (i = 0; i < game->dirty.num_rects; i++)
+		graphics_world_repair(game, game->dirty.rect[i]);
 
-	/* Draw entities on screen. */
-	for (i = 0; i < game->num_goodies; i++)
-		graphics_entity_draw(game, ENTITY_GOODIE, (struct pc *) &(game->goodie[i]));
+	/* Update on-screen info text. */
+	graphics_text_update(game);
 
-	for (i = 0; i < game->num_zombies; i++)
-		graphics_entity_draw(game, ENTITY_ZOMBIE, (struct pc *) &(game->zombie[i]));
+	dx = game->camera.x - game->dirty.camera.x;
+	dy = game->camera.y - game->dirty.camera.y;
 
-	graphics_entity_draw(game, ENTITY_PLAYER, &(game->player));
+	if (game->dirty.all || abs(dx) >= game->screen_w || abs(dy) >= game->screen_h) {
+		/* Copy from 'world' to 'screen' using 'camera' as a viewport. */
+		graphics_world_blit(game, game->camera, game->screen, 0, 0, false);
 
-	/* Copy from 'world' to 'screen' using 'camera' as a viewport. */
-	SDL_BlitSurface(game->world, &game->camera, game->screen, NULL);
+		for (i = 0; i < GRAPHICS_TEXTS; i++)
+			graphics_text_show(game, i);
 
-	/* Update on-screen info text. */
-	graphics_text_update(game);
+		game->render->present(game->screen, 0, NULL);
+
+		game->dirty.camera = game->camera;
+		game->dirty.num_rects = 0;
+		game->dirty.all = false;
+		return;
+	}
+
+	if (dx != 0 || dy != 0) {
+		/* Take the text off the screen before it scrolls along with the level, ... */
+		for (i = 0; i < GRAPHICS_TEXTS; i++) {
+			src = graphics_text[i].shown;
+			src.x += game->dirty.camera.x, src.y += game->dirty.camera.y;
+			graphics_world_blit(game, src, game->screen, graphics_text[i].shown.x, graphics_text[i].shown.y, false);
+			graphics_text[i].changed = true;
+		}
+
+		/* ... move what is still in view, ... */
+		src.x = dx > 0 ? dx : 0, src.y = dy > 0 ? dy : 0;
+		src.w = game->screen_w - abs(dx), src.h = game->screen_h - abs(dy);
+		dst.x = dx < 0 ? -dx : 0, dst.y = dy < 0 ? -dy : 0;
+		game->render->copy(game->screen, &src, game->screen, &dst);
+
+		/* ... and fill in the edges that came into view. */
+		if (dx != 0) {
+			rect[num_rects].x = dx > 0 ? game->screen_w - dx : 0, rect[num_rects].y = 0;
+			rect[num_rects].w = abs(dx), rect[num_rects].h = game->screen_h;
+			num_rects++;
+		}
+
+		if (dy != 0) {
+			rect[num_rects].x = 0, rect[num_rects].y = dy > 0 ? game->screen_h - dy : 0;
+			rect[num_rects].w = game->screen_w, rect[num_rects].h = abs(dy);
+			num_rects++;
+		}
+	}
+
+	/* Parts of the level that changed, as they are on the screen now. */
+	for (i = 0; i < game->dirty.num_rects; i++) {
+		rect[num_rects] = game->dirty.rect[i];
+		rect[num_rects].x -= game->camera.x, rect[num_rects].y -= game->camera.y;
+		if (graphics_screen_clip(game, &rect[num_rects]))
+			num_rects++;
+	}
+
+	/* Text has to be drawn again over any changes underneath it, and cleared
+	 * first, which may in turn run into other text. */
+	for (i = 0; i < GRAPHICS_TEXTS; i++)
+		drawn[i] = false;
+
+	do {
+		added = false;
+
+		for (i = 0; i < GRAPHICS_TEXTS; i++) {
+			for (n = 0; n < num_rects && !graphics_text[i].changed; n++)
+				graphics_text[i].changed = graphics_rect_overlap(graphics_text[i].shown, rect[n]);
+
+			if (!graphics_text[i].changed || drawn[i])
+				continue;
+
+			rect[num_rects] = graphics_text[i].shown;
+			if (graphics_screen_clip(game, &rect[num_rects]))
+				num_rects++;
+
+			rect[num_rects] = graphics_text[i].rect;
+			if (graphics_screen_clip(game, &rect[num_rects]))
+				num_rects++;
+
+			drawn[i] = added = true;
+		}
+	} while (added);
+
+	for (i = 0; i < num_rects; i++) {
+		src = rect[i];
+		src.x += game->camera.x, src.y += game->camera.y;
+		graphics_world_blit(game, src, game->screen, rect[i].x, rect[i].y, false);
+	}
+
+	for (i = 0; i < GRAPHICS_TEXTS; i++) {
+		if (drawn[i])
+			graphics_text_show(game, i);
+	}
+
+	/* Everything moved if we scrolled, otherwise only show what changed. */
+	if (dx != 0 || dy != 0)
+		game->render->present(game->screen, 0, NULL);
+	else
+		game->render->present(game->screen, num_rects, rect);
 
-	SDL_Flip(game->screen);
+	game->dirty.camera = game->camera;
+	game->dirty.num_rects = 0;
 }
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "game.h"
+#include "levels.h"
+#include "pack.h"
+
+static void levelc_usage(void)
+{
+	printf(	"Usage: spooky-levelc DIRECTORY OUTPUT\n"
+		"Compiles the 'level-<number>.txt' files in DIRECTORY into a level pack\n"
+		"written to OUTPUT, which the game reads instead of the text files.\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int n, x, y, w, h, num_levels = 0;
+	size_t len = 0, size = 0;
+	FILE *file;
+	char filename[256], *tiles, *data = NULL;
+	struct pack_header header;
+	struct pack_level *level;
+
+	if (argc != 3)
+		levelc_usage();
+
+	/* Levels are numbered from 0, the same way the game looks for them. */
+	for (n = 0; ; n++) {
+		snprintf(filename, 256, "%s%s-%d.txt", argv[1], "/level", n);
+
+		file = fopen(filename, "r");
+		if (file == NULL)
+			break;
+
+		tiles = pack_parse(file, &w, &h);
+		if (tiles == NULL) {
+			fprintf(stderr, "spooky-levelc: Error: '%s' has rows of different lengths, or more than %d rows or columns!\n",
+				filename, LEVEL_MAX);
+			exit(1);
+		}
+
+		fclose(file);
+
+		while (len + PACK_LEVEL_SIZE(w, h) > size) {
+			size = size ? size * 2 : PACK_LEVEL_SIZE(LEVEL_W, LEVEL_H) * 8;
+			data = realloc(data, size);
+			if (data == NULL) {
+				fprintf(stderr, "spooky-levelc: Error: Out of memory!\n");
+				exit(1);
+			}
+		}
+
+		level = (struct pack_level *) (data + len);
+		memset(level, 0, PACK_LEVEL_SIZE(w, h));
+		level->w = w;
+		level->h = h;
+		memcpy(level->tiles, tiles, w * h);
+
+		for (y = 0; y < h; y++)
+			for (x = 0; x < w; x++)
+				level->num_floor += (tiles[y * w + x] == TILE_FLOOR);
+
+		free(tiles);
+		len += PACK_LEVEL_SIZE(w, h);
+		num_levels++;
+	}
+
+	if (num_levels == 0) {
+		fprintf(stderr, "spooky-levelc: Error: No levels found in '%s'.\n", argv[1]);
+		exit(1);
+	}
+
+	header.magic = PACK_MAGIC;
+	header.version = PACK_VERSION;
+	header.num_levels = num_levels;
+	header.checksum = pack_checksum(data, len);
+
+	file = fopen(argv[2], "wb");
+	if (file == NULL) {
+		fprintf(stderr, "spooky-levelc: Error: Could not open '%s' for writing.\n", argv[2]);
+		exit(1);
+	}
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+	    fwrite(data, 1, len, file) != len ||
+	    fclose(file) != 0) {
+		fprintf(stderr, "spooky-levelc: Error: Could not write '%s'.\n", argv[2]);
+		remove(argv[2]);
+		exit(1);
+	}
+
+	printf("spooky-levelc: Packed %d levels into '%s'.\n", num_levels, argv[2]);
+	free(data);
+
+	return 0;
+}
@@ -1,37 +1,54 @@
 #include <stdio.h>
+#include <string.h>
+#include <dirent.h>
 #include <SDL.h>
 
 #include "game.h"
 #include "graphics.h"
 #include "levels.h"
+#include "maze.h"
+#include "pack.h"
+#include "path.h"
+#include "zombie.h"
+
+static void level_sight_area(const struct level_map *level, Uint64 *sight, int x1, int y1, int x2, int y2);
+static int level_regions_list(const struct level_map *level, int *region, int *first, struct node *tiles);
 
 void level_clear(struct game_data *game)
 {
 	int x, y;
+	struct level_map *level = &game->level;
 
 	/* Clear goodies off the level. */
-	for (y = 0; y < LEVEL_H; y++)
-		for (x = 0; x < LEVEL_W; x++) {
-			if (game->level[y][x] == TILE_GOODIE)
-				game->level[y][x] = TILE_FLOOR;
+	for (y = 0; y < level->h; y++)
+		for (x = 0; x < level->w; x++) {
+			if (LEVEL_TILE(level, x, y) == TILE_GOODIE)
+				LEVEL_TILE(level, x, y) = TILE_FLOOR;
 		}
 
 	/* Set entrance into place. */
-	for (y = 0; y < LEVEL_H; y++) {
-		if ((game->level[y][0] == TILE_UNWALKABLE) || 
-		    (game->level[y][0] == TILE_FLOOR)) {
-			game->level[y][0] = TILE_DOOR;
+	for (y = 0; y < level->h; y++) {
+		if ((LEVEL_TILE(level, 0, y) == TILE_UNWALKABLE) || 
+		    (LEVEL_TILE(level, 0, y) == TILE_FLOOR)) {
+			LEVEL_TILE(level, 0, y) = TILE_DOOR;
+			level_sight_update(game, 0, y);
+			level_solid_update(game, 0, y);
 			break;
 		}
 	}
 
 	/* Close exit if open. */
-	for (y = 0; y < LEVEL_H; y++) {
-		if (game->level[y][LEVEL_W - 1] == TILE_EXIT) {
-			game->level[y][LEVEL_W - 1] = TILE_DOOR;
+	for (y = 0; y < level->h; y++) {
+		if (LEVEL_TILE(level, level->w - 1, y) == TILE_EXIT) {
+			LEVEL_TILE(level, level->w - 1, y) = TILE_DOOR;
+			level_solid_update(game, level->w - 1, y);
 			break;
 		}
 	}
+
+	/* Walkable tiles have changed, so the flow field is no longer valid. */
+	path_flow_reset();
+	level_regions_build(game);
 }
 
 bool level_collision(SDL_Rect entity, SDL_Rect wall)
@@ -57,15 +74,339 @@ bool level_collision(SDL_Rect entity, SDL_Rect wall)
 	return false;
 }
 
+/*
+ * Returns the bits 'tile' sets in 'game->solid'.
+ */
+static Uint32 level_solid_bits(char tile)
+{
+	switch (tile) {
+	case TILE_WALL:
+		return SOLID_PLAYER | SOLID_ZOMBIE;
+	case TILE_DOOR:
+		return SOLID_PLAYER;
+	case TILE_UNWALKABLE:
+		return SOLID_ZOMBIE;
+	default:
+		return 0;
+	}
+}
+
+bool level_solid(struct game_data *game, int x, int y, int solid)
+{
+	int index;
+
+	if (x < 0 || x >= game->level.w || y < 0 || y >= game->level.h)
+		return true;
+
+	index = LEVEL_INDEX(&game->level, x, y);
+
+	return (game->solid[index / 16] >> (index % 16 * 2)) & solid;
+}
+
+SDL_Rect level_wall(struct game_data *game, int x, int y)
+{
+	int i, index = LEVEL_INDEX(&game->level, x, y);
+	SDL_Rect wall;
+
+	wall.x = x * TILE_SIZE;
+	wall.y = y * TILE_SIZE;
+	wall.w = wall.h = TILE_SIZE;
+
+	/* Doors are drawn on the right half of their tile, see 'graphics_level_render()'. */
+	for (i = 0; i < game->num_doors; i++) {
+		if (game->door[i] == index) {
+			wall.x += TILE_SIZE / 2;
+			wall.w = TILE_SIZE / 2;
+			break;
+		}
+	}
+
+	return wall;
+}
+
+void level_solid_build(struct game_data *game)
+{
+	int x, y;
+
+	game->num_doors = 0;
+
+	for (y = 0; y < game->level.h; y++)
+		for (x = 0; x < game->level.w; x++) {
+			level_solid_update(game, x, y);
+
+			/* The player stands in the entrance by the time the level
+			 * is drawn, so it is drawn as floor, see 'level_entities_set()'.
+			 * Doors beyond the first few block with their whole tile. */
+			if (LEVEL_TILE(&game->level, x, y) == TILE_DOOR && x > 0 && game->num_doors < LEVEL_DOORS)
+				game->door[game->num_doors++] = LEVEL_INDEX(&game->level, x, y);
+		}
+}
+
+void level_solid_update(struct game_data *game, int x, int y)
+{
+	int index = LEVEL_INDEX(&game->level, x, y);
+	int shift = index % 16 * 2;
+
+	game->solid[index / 16] &= ~(3u << shift);
+	game->solid[index / 16] |= level_solid_bits(LEVEL_TILE(&game->level, x, y)) << shift;
+}
+
+/*
+ * Resize 'ptr' to 'size' bytes, exiting if we have run out of memory.
+ */
+static void *level_realloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (ptr == NULL) {
+		printf("Error: Out of memory!\nExiting...\n");
+		game_terminate(0);
+	}
+
+	return ptr;
+}
+
+void level_map_init(struct level_map *map, int w, int h)
+{
+	if (w < 3 || w > LEVEL_MAX || h < 3 || h > LEVEL_MAX) {
+		printf("Error: Levels must be from 3 to %d tiles on either side, not %dx%d!\nExiting...\n",
+		       LEVEL_MAX, w, h);
+		game_terminate(0);
+	}
+
+	map->w = w, map->h = h;
+	map->chunks_h = (h + LEVEL_CHUNK - 1) / LEVEL_CHUNK;
+
+	for (map->chunks_shift = 0; (1 << map->chunks_shift) * LEVEL_CHUNK < w; map->chunks_shift++)
+		;
+	map->chunks_w = 1 << map->chunks_shift;
+
+	/* Tiles filling up the last chunks are never walked on or seen through. */
+	map->tiles = level_realloc(map->tiles, LEVEL_SIZE(map));
+	memset(map->tiles, TILE_UNWALKABLE, LEVEL_SIZE(map));
+}
+
+void level_resize(struct game_data *game, int w, int h)
+{
+	int size;
+
+	if (game->level.tiles != NULL && game->level.w == w && game->level.h == h)
+		return;
+
+	level_map_init(&game->level, w, h);
+	size = LEVEL_SIZE(&game->level);
+
+	game->sight = level_realloc(game->sight, sizeof(Uint64) * size);
+	game->region = level_realloc(game->region, sizeof(int) * size);
+	game->region_first = level_realloc(game->region_first, sizeof(int) * (size + 1));
+	game->region_tiles = level_realloc(game->region_tiles, sizeof(struct node) * size);
+	game->spawn = level_realloc(game->spawn, sizeof(struct node) * size);
+	game->solid = level_realloc(game->solid, sizeof(Uint32) * size / 16);
+	game->zombie_grid = level_realloc(game->zombie_grid, sizeof(int) * size);
+	game->goodie_grid = level_realloc(game->goodie_grid, sizeof(int) * size);
+}
+
+int level_index(struct game_data *game)
+{
+	DIR *dir;
+	char filename[256];
+	struct dirent *file;
+
+	snprintf(filename, 256, "%s%s", game->datadir, "/levels.pack");
+
+	game->pack = pack_map(filename);
+	if (game->pack != NULL)
+		return game->num_levels = game->pack->num_levels;
+
+	/* No usable pack, so count the text files instead. */
+	game->num_levels = 0;
+	snprintf(filename, 256, "%s%s", game->datadir, "/levels/");
+
+	dir = opendir(filename);
+	if (dir == NULL)
+		return 0;
+
+	while ((file = readdir(dir)) != NULL) {
+		if (strncmp("level-", file->d_name, 6) == 0)
+			game->num_levels++;
+	}
+
+	closedir(dir);
+
+	return game->num_levels;
+}
+
+/*
+ * Work out everything 'level_load()' copies along with the tiles of 'variant',
+ * other than its number of floor tiles. Only touches 'variant', so it may run on
+ * any thread.
+ */
+static void level_variant_build(struct level_variant *variant)
+{
+	level_sight_area(&variant->level, variant->sight, 0, 0, variant->level.w - 1, variant->level.h - 1);
+	variant->num_regions = level_regions_list(&variant->level, variant->region,
+						  variant->region_first, variant->region_tiles);
+}
+
+/*
+ * Set 'variant' up for a level of 'w' by 'h' tiles, reallocating its arrays.
+ */
+static void level_variant_alloc(struct level_variant *variant, int w, int h)
+{
+	int size;
+
+	level_map_init(&variant->level, w, h);
+	size = LEVEL_SIZE(&variant->level);
+
+	variant->sight = level_realloc(variant->sight, sizeof(Uint64) * size);
+	variant->region = level_realloc(variant->region, sizeof(int) * size);
+	variant->region_first = level_realloc(variant->region_first, sizeof(int) * (size + 1));
+	variant->region_tiles = level_realloc(variant->region_tiles, sizeof(struct node) * size);
+}
+
+/*
+ * Load the level kept at 'index' in 'game->cache' into 'game'.
+ */
+static void level_use(struct game_data *game, int index)
+{
+	struct level_variant *cached = &game->cache[index];
+	int size = LEVEL_SIZE(&cached->level);
+
+	level_resize(game, cached->level.w, cached->level.h);
+
+	memcpy(game->level.tiles, cached->level.tiles, size);
+	memcpy(game->sight, cached->sight, sizeof(Uint64) * size);
+	memcpy(game->region, cached->region, sizeof(int) * size);
+
+	/* Only the parts of the region lists in use need copying. */
+	memcpy(game->region_first, cached->region_first, sizeof(int) * (cached->num_regions + 1));
+	memcpy(game->region_tiles, cached->region_tiles, sizeof(struct node) * cached->region_first[cached->num_regions]);
+	game->num_floor = cached->num_floor;
+	game->num_regions = cached->num_regions;
+
+	/* Every floor tile is in one of the regions, so their lists cover them all. */
+	memcpy(game->spawn, cached->region_tiles, sizeof(struct node) * cached->num_floor);
+
+	level_solid_build(game);
+	path_flow_reset();
+}
+
+/*
+ * Generate a level from 'seed' into the slot for generated levels in 'game->cache',
+ * returning its index. Only touches that slot, which 'level_cache_build()' sets up
+ * for levels of 'game->maze_w' by 'game->maze_h' tiles, so it may run on any thread.
+ */
+static int level_maze(struct game_data *game, Uint32 seed)
+{
+	struct level_variant *generated = &game->cache[game->num_levels * 4];
+
+	generated->num_floor = maze_generate(&generated->level, seed);
+	level_variant_build(generated);
+
+	return game->num_levels * 4;
+}
 
 void level_generate(struct game_data *game)
 {
-	int x, y, i;
+	int number;
+	bool mirror, flip;
+
+	if (game->cache == NULL)
+		level_cache_build(game);
+
+	if (game->maze) {
+		level_use(game, level_maze(game, rand()));
+		return;
+	}
+
+	/* Choose a random level, and whether to mirror and flip it. */
+	number = rand() % game->num_levels;
+	mirror = rand() % 2;
+	flip = rand() % 2;
+
+	level_load(game, number, mirror, flip);
+}
+
+/*
+ * Generate the level picked by 'level_preload()' with '-m'. Runs on a thread of
+ * its own, so it only touches the level cache.
+ */
+static int level_prepare(void *data)
+{
+	struct game_data *game = data;
+
+	game->next.index = level_maze(game, game->next.seed);
+
+	return 0;
+}
+
+void level_preload(struct game_data *game)
+{
+	int number;
+	bool mirror, flip;
+
+	/* Make the same draws 'level_generate()' would, on this thread, so that
+	 * the same seed still plays out the same way. */
+	if (game->maze) {
+		game->next.seed = rand();
+		game->next.index = game->num_levels * 4;
+	} else {
+		number = rand() % game->num_levels;
+		mirror = rand() % 2;
+		flip = rand() % 2;
+		game->next.index = number * 4 + mirror + flip * 2;
+	}
+
+	/* Levels from the data directory are ready as they are, and the world is
+	 * drawn bit by bit as it comes into view, so only a generated level is
+	 * left to work on. If the thread can't be started, the level is generated
+	 * once it is needed. */
+	if (game->maze)
+		game->next.thread = SDL_CreateThread(level_prepare, game);
+
+	game->next.ready = true;
+}
+
+void level_advance(struct game_data *game)
+{
+	if (!game->next.ready) {
+		level_generate(game);
+		return;
+	}
+
+	if (game->next.thread != NULL)
+		SDL_WaitThread(game->next.thread, NULL);
+	else if (game->maze)
+		level_prepare(game);
+
+	game->next.thread = NULL;
+	game->next.ready = false;
+
+	level_use(game, game->next.index);
+}
+
+/*
+ * Read level 'number' as it was written, from the level pack or its text file,
+ * setting 'w' and 'h' to its size and 'num_floor' to its number of floor tiles.
+ * Returns its tiles row by row, which have to be freed with 'free()' if 'text'
+ * is set. Exits if the level can't be read.
+ */
+static const char *level_read(struct game_data *game, int number, int *w, int *h, int *num_floor, bool *text)
+{
+	int i;
 	FILE *level;
-	char tmp, filename[256];
+	char filename[256], *tiles;
+	const struct pack_level *packed;
+
+	if (game->pack != NULL) {
+		/* Levels in the pack are ready to be used as they are. */
+		packed = pack_level(game->pack, number);
+		*w = packed->w, *h = packed->h;
+		*num_floor = packed->num_floor;
+		*text = false;
+		return packed->tiles;
+	}
 
-	/* Choose a random text file. */
-	snprintf(filename, 256, "%s%s-%d.txt", game->datadir, "/levels/level",  rand() % game->num_levels);
+	snprintf(filename, 256, "%s%s-%d.txt", game->datadir, "/levels/level", number);
 
 	/* Load the text file. */
 	level = fopen(filename, "r");
@@ -74,48 +415,145 @@ void level_generate(struct game_data *game)
 		game_terminate(0);
 	}
 
-	/* Parse text file into 'level' array. */
-	for (y = 0; y <= LEVEL_H; y++) {
-		for (x = 0; x <= LEVEL_W; x++) {
-			fscanf(level, "%c", &tmp);
-			if (tmp == ' ')
-				x--;
-			else if (tmp == '\n')
-				break;
-			else
-				game->level[y][x] = tmp;
-		}
+	tiles = pack_parse(level, w, h);
+	if (tiles == NULL) {
+		printf("Error: Level file '%s' has rows of different lengths, or more than %d rows or columns!\nExiting...\n",
+		       filename, LEVEL_MAX);
+		game_terminate(0);
+	}
 
-		if (feof(level))
-			break;
+	fclose(level);
+
+	*num_floor = 0;
+	for (i = 0; i < *w * *h; i++)
+		*num_floor += (tiles[i] == TILE_FLOOR);
+
+	*text = true;
+	return tiles;
+}
+
+void level_cache_build(struct game_data *game)
+{
+	int n, x, y, w, h, variant, num_floor;
+	bool mirror, flip, text;
+	const char *tiles;
+	struct level_variant *cached;
+
+	/* Keep a slot after the levels for generated ones. */
+	free(game->cache);
+	game->cache = calloc(game->num_levels * 4 + 1, sizeof(struct level_variant));
+	if (game->cache == NULL) {
+		printf("Error: Out of memory for levels!\nExiting...\n");
+		game_terminate(0);
 	}
 
-	/* Should we mirror the level? */
-	if (rand() % 2) {
-		for (y = 0; y < LEVEL_H; y++) {
-			for (x = 0, i = LEVEL_W - 1; x < LEVEL_W / 2; x++, i--) {
-				tmp = game->level[y][i];
-				game->level[y][i] = game->level[y][x];
-				game->level[y][x] = tmp;
-			}
+	for (n = 0; n < game->num_levels; n++) {
+		tiles = level_read(game, n, &w, &h, &num_floor, &text);
+
+		/* Mirrored and flipped variants read the same tiles from the
+		 * other side. */
+		for (variant = 0; variant < 4; variant++) {
+			mirror = variant & 1, flip = variant & 2;
+			cached = &game->cache[n * 4 + variant];
+			level_variant_alloc(cached, w, h);
+
+			for (y = 0; y < h; y++)
+				for (x = 0; x < w; x++)
+					LEVEL_TILE(&cached->level, x, y) = tiles[(flip ? h - 1 - y : y) * w + (mirror ? w - 1 - x : x)];
+
+			cached->num_floor = num_floor;
+			level_variant_build(cached);
 		}
+
+		if (text)
+			free((char *) tiles);
 	}
 
-	/* Should we flip the level? */
-	if (rand() % 2) {
-		for (x = 0; x < LEVEL_W; x++) {
-			for (y = 0, i = LEVEL_H - 1; y < LEVEL_H / 2; y++, i--) {
-				tmp = game->level[i][x];
-				game->level[i][x] = game->level[y][x];
-				game->level[y][x] = tmp;
-			}
+	if (game->maze)
+		level_variant_alloc(&game->cache[game->num_levels * 4], game->maze_w, game->maze_h);
+}
+
+void level_load(struct game_data *game, int number, bool mirror, bool flip)
+{
+	if (game->cache == NULL)
+		level_cache_build(game);
+
+	level_use(game, number * 4 + mirror + flip * 2);
+}
+
+/*
+ * Returns the bit in 'game->sight' for tiles 'dx', 'dy' away, or -1 if they are
+ * not covered by it. Only one bit is kept for each pair of tiles, so the caller
+ * must have swapped the tiles around if 'dy' is negative, or if 'dx' is and 'dy'
+ * is zero.
+ */
+static int level_sight_bit(int dx, int dy)
+{
+	if (abs(dx) > LEVEL_SIGHT || dy > LEVEL_SIGHT)
+		return -1;
+	else if (dy == 0)
+		return dx - 1;
+	else
+		return LEVEL_SIGHT + (dy - 1) * (LEVEL_SIGHT * 2 + 1) + (dx + LEVEL_SIGHT);
+}
+
+bool level_sight(struct game_data *game, int src_x, int src_y, int dest_x, int dest_y)
+{
+	int bit;
+
+	if (src_x == dest_x && src_y == dest_y)
+		return true;
+
+	/* Look up the pair from whichever tile comes first. */
+	if (dest_y < src_y || (dest_y == src_y && dest_x < src_x))
+		bit = level_sight_bit(src_x - dest_x, src_y - dest_y), src_x = dest_x, src_y = dest_y;
+	else
+		bit = level_sight_bit(dest_x - src_x, dest_y - src_y);
+
+	if (bit == -1)
+		return level_tile_visible(src_x, src_y, dest_x, dest_y, &game->level);
+
+	return (game->sight[LEVEL_INDEX(&game->level, src_x, src_y)] >> bit) & 1;
+}
+
+/*
+ * Rebuild 'sight' for all tiles of 'level' from 'x1', 'y1' to 'x2', 'y2'.
+ */
+static void level_sight_area(const struct level_map *level, Uint64 *sight, int x1, int y1, int x2, int y2)
+{
+	int x, y, dx, dy, bit;
+	Uint64 *tile;
+
+	for (y = (y1 < 0) ? 0 : y1; y <= y2 && y < level->h; y++)
+	for (x = (x1 < 0) ? 0 : x1; x <= x2 && x < level->w; x++) {
+		tile = &sight[LEVEL_INDEX(level, x, y)];
+		*tile = 0;
+
+		for (dy = 0; dy <= LEVEL_SIGHT && y + dy < level->h; dy++)
+		for (dx = (dy == 0) ? 1 : -LEVEL_SIGHT; dx <= LEVEL_SIGHT; dx++) {
+			if (x + dx < 0 || x + dx >= level->w)
+				continue;
+
+			bit = level_sight_bit(dx, dy);
+			if (level_tile_visible(x, y, x + dx, y + dy, level))
+				*tile |= (Uint64) 1 << bit;
 		}
 	}
+}
 
-	fclose(level);
+void level_sight_build(struct game_data *game)
+{
+	level_sight_area(&game->level, game->sight, 0, 0, game->level.w - 1, game->level.h - 1);
+}
+
+void level_sight_update(struct game_data *game, int x, int y)
+{
+	/* Only pairs of tiles that both lie within sight of the tile that has
+	 * changed can have a line between them passing through it. */
+	level_sight_area(&game->level, game->sight, x - LEVEL_SIGHT, y - LEVEL_SIGHT, x + LEVEL_SIGHT, y + LEVEL_SIGHT);
 }
 
-int level_tile_visible(int src_x, int src_y, int dest_x, int dest_y, char level[LEVEL_H][LEVEL_W])
+int level_tile_visible(int src_x, int src_y, int dest_x, int dest_y, const struct level_map *level)
 {
 	int x = src_x, y = src_y;
 
@@ -131,7 +569,7 @@ int level_tile_visible(int src_x, int src_y, int dest_x, int dest_y, char level[
 		else if (y > dest_y)
 			y--;
 
-		switch (level[y][x]) {
+		switch (LEVEL_TILE(level, x, y)) {
 			case TILE_WALL:
 				return false;
 			case TILE_UNWALKABLE:
@@ -151,7 +589,7 @@ int level_tile_visible(int src_x, int src_y, int dest_x, int dest_y, char level[
 		else if (y > src_y)
 			y--;
 
-		switch (level[y][x]) {
+		switch (LEVEL_TILE(level, x, y)) {
 			case TILE_WALL:
 				return false;
 			case TILE_UNWALKABLE:
@@ -167,76 +605,272 @@ void level_unlock(struct game_data *game)
 	int y;
 	//~ SDL_Rect tmp;
 
-	for (y = 0; y < LEVEL_H; y++) {
-		if (game->level[y][LEVEL_W - 1] == TILE_DOOR) {
-			game->level[y][LEVEL_W - 1] = TILE_EXIT;
+	for (y = 0; y < game->level.h; y++) {
+		if (LEVEL_TILE(&game->level, game->level.w - 1, y) == TILE_DOOR) {
+			LEVEL_TILE(&game->level, game->level.w - 1, y) = TILE_EXIT;
+			level_solid_update(game, game->level.w - 1, y);
 
 			//~ TODO: Draw for tiles.
-			//~ tmp = game->wall[y][LEVEL_W - 1];
+			//~ tmp = level_wall(game, game->level.w - 1, y);
 			//~ graphics_iso_convert(tmp.x, tmp.y, (int *) &(tmp.x), (int *) &(tmp.y));
 			//~ graphics_tile_draw(game, TILE_FLOOR, tmp);
 			break;
 		}
 	}
+
+	/* The exit is walkable now, so the flow field is no longer valid. */
+	path_flow_reset();
+	level_regions_build(game);
+}
+
+/*
+ * Number the walkable regions of 'level' into 'region' and list the floor tiles
+ * of each in 'tiles', from 'first[r]' up to 'first[r + 1]'. Returns the number
+ * of regions.
+ */
+static int level_regions_list(const struct level_map *level, int *region, int *first, struct node *tiles)
+{
+	int x, y, r, num_regions;
+
+	num_regions = path_regions(level, region);
+
+	/* Count the floor tiles in each region, ... */
+	for (r = 0; r <= num_regions; r++)
+		first[r] = 0;
+
+	for (y = 0; y < level->h; y++)
+		for (x = 0; x < level->w; x++) {
+			r = region[LEVEL_INDEX(level, x, y)];
+			if (r != -1 && LEVEL_TILE(level, x, y) == TILE_FLOOR)
+				first[r + 1]++;
+		}
+
+	for (r = 0; r < num_regions; r++)
+		first[r + 1] += first[r];
+
+	/* ... list them, using the start of each region's list as a cursor, ... */
+	for (y = 0; y < level->h; y++)
+		for (x = 0; x < level->w; x++) {
+			r = region[LEVEL_INDEX(level, x, y)];
+			if (r != -1 && LEVEL_TILE(level, x, y) == TILE_FLOOR) {
+				tiles[first[r]].x = x;
+				tiles[first[r]].y = y;
+				first[r]++;
+			}
+		}
+
+	/* ... and move the cursors back to where each list starts. */
+	for (r = num_regions; r > 0; r--)
+		first[r] = first[r - 1];
+	first[0] = 0;
+
+	return num_regions;
+}
+
+void level_regions_build(struct game_data *game)
+{
+	game->num_regions = level_regions_list(&game->level, game->region, game->region_first, game->region_tiles);
+}
+
+void level_entities_alloc(struct game_data *game)
+{
+	int size;
+
+	/* Grow the zombie arrays, at least doubling them to keep growth cheap. */
+	if (game->num_zombies > game->zombie.size) {
+		size = game->zombie.size * 2;
+		if (size < game->num_zombies)
+			size = game->num_zombies;
+
+		game->zombie.rect = level_realloc(game->zombie.rect, sizeof(SDL_Rect) * size);
+		game->zombie.iso = level_realloc(game->zombie.iso, sizeof(struct iso) * size);
+		game->zombie.dest = level_realloc(game->zombie.dest, sizeof(struct node) * size);
+		game->zombie.num_nodes = level_realloc(game->zombie.num_nodes, sizeof(int) * size);
+		game->zombie.path = level_realloc(game->zombie.path, sizeof(struct node) * PATH_SIZE * size);
+		game->zombie.seed = level_realloc(game->zombie.seed, sizeof(Uint32) * size);
+		game->zombie.request = level_realloc(game->zombie.request, sizeof(int) * size);
+		game->zombie.ticket = level_realloc(game->zombie.ticket, sizeof(int) * size);
+		game->zombie.want = level_realloc(game->zombie.want, sizeof(struct node) * size);
+		game->zombie.cell = level_realloc(game->zombie.cell, sizeof(int) * size);
+		game->zombie.cell_next = level_realloc(game->zombie.cell_next, sizeof(int) * size);
+		game->zombie.drawn = level_realloc(game->zombie.drawn, sizeof(bool) * size);
+		game->zombie.shown = level_realloc(game->zombie.shown, sizeof(struct iso) * size);
+
+		/* Each zombie waits for one path at most. */
+		game->path_queue.request = level_realloc(game->path_queue.request, sizeof(struct path_request) * size);
+		game->path_queue.size = size;
+
+		game->zombie.size = size;
+	}
+
+	if (game->num_goodies > game->goodie.size) {
+		size = game->goodie.size * 2;
+		if (size < game->num_goodies)
+			size = game->num_goodies;
+
+		game->goodie.rect = level_realloc(game->goodie.rect, sizeof(SDL_Rect) * size);
+		game->goodie.iso = level_realloc(game->goodie.iso, sizeof(struct iso) * size);
+		game->goodie.cell = level_realloc(game->goodie.cell, sizeof(int) * size);
+		game->goodie.cell_next = level_realloc(game->goodie.cell_next, sizeof(int) * size);
+
+		game->goodie.size = size;
+	}
+}
+
+int level_goodie_first(struct game_data *game, int x, int y)
+{
+	if (x < 0 || x >= game->level.w || y < 0 || y >= game->level.h)
+		return -1;
+
+	return game->goodie_grid[LEVEL_INDEX(&game->level, x, y)];
+}
+
+void level_goodie_remove(struct game_data *game, int i)
+{
+	int *n, last;
+
+	/* Unlink from its tile, ... */
+	n = &game->goodie_grid[game->goodie.cell[i]];
+	while (*n != i)
+		n = &game->goodie.cell_next[*n];
+	*n = game->goodie.cell_next[i];
+
+	if (game->goodie_grid[game->goodie.cell[i]] == -1)
+		game->level.tiles[game->goodie.cell[i]] = TILE_FLOOR;
+
+	last = --game->num_goodies;
+	if (i == last)
+		return;
+
+	/* ... and link the last goodie into the same place under its new number. */
+	n = &game->goodie_grid[game->goodie.cell[last]];
+	while (*n != last)
+		n = &game->goodie.cell_next[*n];
+	*n = i;
+
+	game->goodie.rect[i] = game->goodie.rect[last];
+	game->goodie.iso[i] = game->goodie.iso[last];
+	game->goodie.cell[i] = game->goodie.cell[last];
+	game->goodie.cell_next[i] = game->goodie.cell_next[last];
+}
+
+/* Floor tiles left to pick from in 'game->spawn', see 'level_spawn_pick()'. */
+struct level_spawn {
+	int first;	/* Tiles before this one have been picked already. */
+	int last;	/* Tiles from this one on are too close to the entrance. */
+	int near;	/* Least distance from the entrance on either axis, or 0 for any. */
+	int entrance;	/* Row of the entrance. */
+};
+
+/*
+ * Pick a random tile out of 'spawn', moving it in front of the tiles left so that
+ * it isn't picked again, and moving tiles closer than 'spawn->near' to the entrance
+ * behind them as they turn up. Once every tile has been picked, picks them again,
+ * including the ones close to the entrance if there are no others. There has to
+ * be at least one floor tile.
+ */
+static struct node level_spawn_pick(struct game_data *game, struct level_spawn *spawn)
+{
+	int i;
+	struct node tile;
+
+	for (;;) {
+		if (spawn->first == spawn->last) {
+			if (spawn->first == 0)
+				spawn->near = 0, spawn->last = game->num_floor;
+			spawn->first = 0;
+		}
+
+		i = spawn->first + rand() % (spawn->last - spawn->first);
+		tile = game->spawn[i];
+
+		if (tile.x < spawn->near && abs(tile.y - spawn->entrance) < spawn->near) {
+			game->spawn[i] = game->spawn[--spawn->last];
+			game->spawn[spawn->last] = tile;
+			continue;
+		}
+
+		game->spawn[i] = game->spawn[spawn->first];
+		game->spawn[spawn->first++] = tile;
+
+		return tile;
+	}
 }
 
 void level_entities_set(struct game_data *game)
 {
-	int x, y, i;
+	int i, y;
+	struct node tile;
+	struct level_map *level = &game->level;
+	struct level_spawn zombies = { 0, game->num_floor, 0, 0 };
+	struct level_spawn goodies = { 0, game->num_floor, 0, 0 };
 
 	/* Place our player in the level entrance. */
-	for (y = 0; y < LEVEL_H; y++) {
-		if (game->level[y][0] == TILE_DOOR) {
-			game->level[y][0] = TILE_UNWALKABLE;
+	for (y = 0; y < level->h; y++) {
+		if (LEVEL_TILE(level, 0, y) == TILE_DOOR) {
+			LEVEL_TILE(level, 0, y) = TILE_UNWALKABLE;
+			level_sight_update(game, 0, y);
+			level_solid_update(game, 0, y);
 			game->player.rect.y = TILE_SIZE * y;
 			game->player.rect.x = 0;
 			game->player.rect.w = ENTITY_W;
 			game->player.rect.h = ENTITY_H;
 			game->player.dir_x = 0, game->player.dir_y = 0;
 
-			graphics_iso_convert(&(game->player));
-
-			game->player.bg = graphics_surface_init(ENTITY_W, ENTITY_H);
+			game->player.iso = graphics_iso_convert(game, game->player.rect);
 
+			zombies.near = LEVEL_SPAWN;
+			zombies.entrance = y;
 			break;
 		}
 	}
 
+	/* Goodies each need a floor tile of their own, and zombies need at least
+	 * one floor tile to share. */
+	if (game->num_goodies > game->num_floor)
+		game->num_goodies = game->num_floor;
+	if (game->num_floor == 0)
+		game->num_zombies = 0;
+
+	level_entities_alloc(game);
+
 	/* Place zombies in random locations in the level. */
 	for (i = 0; i < game->num_zombies; i++) {
-		x = rand() % LEVEL_W, y = rand() % LEVEL_H;
-		if (game->level[y][x] == TILE_FLOOR) {
-			game->zombie[i].rect.x = x * TILE_SIZE;
-			game->zombie[i].rect.y = y * TILE_SIZE;
-			game->zombie[i].rect.w = ENTITY_W;
-			game->zombie[i].rect.h = ENTITY_H;
-			game->zombie[i].num_nodes = 0;
-			game->zombie[i].dest_x = 0;
-			game->zombie[i].dest_y = 0;
+		tile = level_spawn_pick(game, &zombies);
+
+		game->zombie.rect[i].x = tile.x * TILE_SIZE;
+		game->zombie.rect[i].y = tile.y * TILE_SIZE;
+		game->zombie.rect[i].w = ENTITY_W;
+		game->zombie.rect[i].h = ENTITY_H;
+		game->zombie.num_nodes[i] = 0;
+		game->zombie.dest[i].x = 0;
+		game->zombie.dest[i].y = 0;
+		game->zombie.seed[i] = rand() | 1;
+		game->zombie.request[i] = ZOMBIE_IDLE;
+
+		game->zombie.iso[i] = graphics_iso_convert(game, game->zombie.rect[i]);
+	}
 
-			graphics_iso_convert((struct pc *) &(game->zombie[i]));
+	zombie_grid_build(game);
+	zombie_queue_clear(game);
 
-			game->zombie[i].bg = graphics_surface_init(ENTITY_W, ENTITY_H);
-		} else {
-			--i;
-		}
-	}
+	for (i = 0; i < LEVEL_SIZE(level); i++)
+		game->goodie_grid[i] = -1;
 
 	/* Place goodies in random locations in the level. */
 	for (i = 0; i < game->num_goodies; i++) {
-		x = rand() % LEVEL_W, y = rand() % LEVEL_H;
-		if (game->level[y][x] == TILE_FLOOR) {
-			game->level[y][x] = TILE_GOODIE;
-			game->goodie[i].rect.x = (TILE_SIZE * x) + (rand() % TILE_SIZE);
-			game->goodie[i].rect.y = (TILE_SIZE * y) + (rand() % TILE_SIZE);
-			game->goodie[i].rect.w = GOODIE_W;
-			game->goodie[i].rect.h = GOODIE_H;
+		tile = level_spawn_pick(game, &goodies);
 
-			graphics_iso_convert((struct pc *) &(game->goodie[i]));
+		LEVEL_TILE(level, tile.x, tile.y) = TILE_GOODIE;
+		game->goodie.rect[i].x = (TILE_SIZE * tile.x) + (rand() % TILE_SIZE);
+		game->goodie.rect[i].y = (TILE_SIZE * tile.y) + (rand() % TILE_SIZE);
+		game->goodie.rect[i].w = GOODIE_W;
+		game->goodie.rect[i].h = GOODIE_H;
 
-			game->goodie[i].bg = graphics_surface_init(GOODIE_W, GOODIE_H);
-		} else {
-			--i;
-		}
+		game->goodie.cell[i] = LEVEL_INDEX(level, tile.x, tile.y);
+		game->goodie.cell_next[i] = game->goodie_grid[game->goodie.cell[i]];
+		game->goodie_grid[game->goodie.cell[i]] = i;
+
+		game->goodie.iso[i] = graphics_iso_convert(game, game->goodie.rect[i]);
 	}
 }
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "game.h"
+#include "levels.h"
+#include "maze.h"
+
+/*
+ * Returns the next number in the xorshift sequence kept in '*seed'.
+ */
+static int maze_rand(Uint32 *seed)
+{
+	Uint32 x = *seed;
+
+	x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+	*seed = x;
+
+	return x >> 1;
+}
+
+/*
+ * Fill 'level' with floor surrounded by walls, with doors in rows 'entrance' and
+ * 'exit' of the left and right sides.
+ */
+static void maze_room(struct level_map *level, int entrance, int exit)
+{
+	int x, y;
+
+	for (y = 0; y < level->h; y++)
+		for (x = 0; x < level->w; x++) {
+			if (x == 0 || y == 0 || x == level->w - 1 || y == level->h - 1)
+				LEVEL_TILE(level, x, y) = TILE_WALL;
+			else
+				LEVEL_TILE(level, x, y) = TILE_FLOOR;
+		}
+
+	LEVEL_TILE(level, 0, entrance) = TILE_DOOR;
+	LEVEL_TILE(level, level->w - 1, exit) = TILE_DOOR;
+}
+
+/*
+ * Wall off every floor tile the player can't walk to from the entrance, moving
+ * one tile at a time on either axis so that no corners need cutting. 'seen' and
+ * 'stack' need room for an entry for each tile. Returns the number of floor tiles
+ * left, or 0 if the exit can't be reached.
+ */
+static int maze_fill(struct level_map *level, int entrance, int exit, bool *seen, int *stack)
+{
+	int i, x, y, tile, len, num_floor = 0;
+	int next[4];
+
+	memset(seen, 0, sizeof(bool) * LEVEL_SIZE(level));
+
+	/* The tile in front of the entrance is always floor, see 'maze_generate()'. */
+	seen[LEVEL_INDEX(level, 1, entrance)] = true;
+	stack[0] = LEVEL_INDEX(level, 1, entrance), len = 1;
+
+	while (len > 0) {
+		tile = stack[--len];
+		x = LEVEL_X(level, tile), y = LEVEL_Y(level, tile);
+		num_floor++;
+
+		/* The border is all walls and doors, so neighbours never fall outside. */
+		next[0] = LEVEL_INDEX(level, x - 1, y);
+		next[1] = LEVEL_INDEX(level, x + 1, y);
+		next[2] = LEVEL_INDEX(level, x, y - 1);
+		next[3] = LEVEL_INDEX(level, x, y + 1);
+
+		for (i = 0; i < 4; i++) {
+			if (level->tiles[next[i]] == TILE_FLOOR && !seen[next[i]])
+				seen[next[i]] = true, stack[len++] = next[i];
+		}
+	}
+
+	if (!seen[LEVEL_INDEX(level, level->w - 2, exit)])
+		return 0;
+
+	for (y = 1; y < level->h - 1; y++)
+		for (x = 1; x < level->w - 1; x++) {
+			if (LEVEL_TILE(level, x, y) == TILE_FLOOR && !seen[LEVEL_INDEX(level, x, y)])
+				LEVEL_TILE(level, x, y) = TILE_WALL;
+		}
+
+	return num_floor;
+}
+
+int maze_generate(struct level_map *level, Uint32 seed)
+{
+	int i, n, x, y, dx, dy, try, length, entrance, exit, num_floor, walls;
+	int interior = (level->w - 2) * (level->h - 2);
+	bool *seen;
+	int *stack;
+
+	seen = malloc(sizeof(bool) * LEVEL_SIZE(level));
+	stack = malloc(sizeof(int) * LEVEL_SIZE(level));
+	if (seen == NULL || stack == NULL) {
+		printf("Error: Out of memory for levels!\nExiting...\n");
+		game_terminate(0);
+	}
+
+	/* A zero seed would get xorshift stuck at zero. */
+	seed |= 1;
+
+	/* Keep walls as dense as they are in a level of the default size. */
+	walls = MAZE_WALLS * interior / ((LEVEL_W - 2) * (LEVEL_H - 2));
+
+	for (try = 0; try < MAZE_TRIES; try++) {
+		entrance = 1 + maze_rand(&seed) % (level->h - 2);
+		exit = 1 + maze_rand(&seed) % (level->h - 2);
+		maze_room(level, entrance, exit);
+
+		/* Scatter straight wall segments over the room, leaving the tiles
+		 * in front of both doors free. */
+		for (i = 0; i < walls; i++) {
+			x = 1 + maze_rand(&seed) % (level->w - 2);
+			y = 1 + maze_rand(&seed) % (level->h - 2);
+			length = 2 + maze_rand(&seed) % (MAZE_LENGTH - 1);
+
+			if (maze_rand(&seed) % 2)
+				dx = 1, dy = 0;
+			else
+				dx = 0, dy = 1;
+
+			for (n = 0; n < length && x < level->w - 1 && y < level->h - 1; n++, x += dx, y += dy) {
+				if ((x == 1 && y == entrance) || (x == level->w - 2 && y == exit))
+					continue;
+
+				LEVEL_TILE(level, x, y) = TILE_WALL;
+			}
+		}
+
+		num_floor = maze_fill(level, entrance, exit, seen, stack);
+		if (num_floor * 100 >= interior * MAZE_FLOOR)
+			break;
+	}
+
+	free(seen);
+	free(stack);
+
+	if (try < MAZE_TRIES)
+		return num_floor;
+
+	/* Walls got in the way every time, so leave the room empty. */
+	maze_room(level, entrance, exit);
+
+	return interior;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <SDL.h>
+
+#include "game.h"
+#include "pack.h"
+
+char *pack_parse(FILE *file, int *w, int *h)
+{
+	int x = 0, n = 0, size = 0, tmp;
+	char *tiles = NULL, *grown;
+
+	*w = 0, *h = 0;
+
+	do {
+		tmp = getc(file);
+
+		if (tmp == EOF || tmp == '\n') {
+			/* A blank line ends the level. */
+			if (x == 0)
+				break;
+
+			/* Every row has to be as long as the first one. */
+			if (*h == 0)
+				*w = x;
+			if (x != *w || ++*h > LEVEL_MAX) {
+				free(tiles);
+				return NULL;
+			}
+
+			x = 0;
+		} else if (tmp != ' ' && tmp != '\r') {
+			/* Spaces are only there for readability. */
+			if (++x > LEVEL_MAX) {
+				free(tiles);
+				return NULL;
+			}
+
+			if (n == size) {
+				size = size ? size * 2 : LEVEL_W * LEVEL_H;
+				grown = realloc(tiles, size);
+				if (grown == NULL) {
+					free(tiles);
+					return NULL;
+				}
+
+				tiles = grown;
+			}
+
+			tiles[n++] = tmp;
+		}
+	} while (tmp != EOF);
+
+	if (*h == 0) {
+		free(tiles);
+		return NULL;
+	}
+
+	return tiles;
+}
+
+Uint32 pack_checksum(const void *data, size_t size)
+{
+	const Uint8 *byte = data;
+	Uint32 hash = 2166136261u;
+
+	/* 32-bit FNV-1a. */
+	while (size-- > 0) {
+		hash ^= *byte++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Returns true if the levels in 'pack' fit in a sensible size each and fill up
+ * exactly the 'size' bytes it takes up.
+ */
+static bool pack_valid(const struct pack_header *pack, off_t size)
+{
+	Uint32 n;
+	off_t offset = sizeof(struct pack_header);
+	const struct pack_level *level;
+
+	for (n = 0; n < pack->num_levels; n++) {
+		if (size - offset < (off_t) sizeof(struct pack_level))
+			return false;
+
+		level = (const struct pack_level *) ((const char *) pack + offset);
+		if (level->w == 0 || level->w > LEVEL_MAX || level->h == 0 || level->h > LEVEL_MAX)
+			return false;
+
+		offset += PACK_LEVEL_SIZE(level->w, level->h);
+		if (offset > size)
+			return false;
+	}
+
+	return offset == size;
+}
+
+const struct pack_header *pack_map(const char *filename)
+{
+	int fd;
+	void *data;
+	struct stat info;
+	const struct pack_header *pack;
+
+	fd = open(filename, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &info) == -1 || info.st_size < (off_t) sizeof(struct pack_header)) {
+		close(fd);
+		return NULL;
+	}
+
+	/* The mapping stays around for as long as the game runs. */
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	pack = data;
+	if (pack->magic != PACK_MAGIC || pack->version != PACK_VERSION || pack->num_levels == 0 ||
+	    !pack_valid(pack, info.st_size) ||
+	    pack->checksum != pack_checksum(pack + 1, info.st_size - sizeof(struct pack_header))) {
+		munmap(data, info.st_size);
+		return NULL;
+	}
+
+	return pack;
+}
+
+const struct pack_level *pack_level(const struct pack_header *pack, int number)
+{
+	const struct pack_level *level = (const struct pack_level *) (pack + 1);
+
+	/* Levels vary in size, so walk over the ones before. */
+	while (number-- > 0)
+		level = (const struct pack_level *) ((const char *) level + PACK_LEVEL_SIZE(level->w, level->h));
+
+	return level;
+}
@@ -0,0 +1,673 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "game.h"
+#include "levels.h"
+#include "path.h"
+
+#define PATH_UNREACHABLE -2
+
+/* Search state of a single tile, which only belongs to the current search if
+ * its 'seen' value matches the search's 'generation', so nothing has to be
+ * cleared between searches. Kept together so that a tile takes a single trip
+ * to memory however large the level is. */
+struct path_tile {
+	Uint32 seen;
+	int cost;		/* Cost of the path so far ('g' in A*). */
+	int score;		/* Estimated total cost ('f' in A*). */
+	int parent;		/* Previous tile in path, or -1 for the source. */
+	int heap_pos;		/* Position in 'heap', or -1 once closed. */
+};
+
+/* State of a single search. Per-tile entries are indexed by 'LEVEL_INDEX()',
+ * and grow to fit the largest level searched, see 'path_fit()'. */
+struct path_state {
+	struct level_map map;	/* Layout of the level searched. */
+	int size;		/* Number of tiles the arrays have room for. */
+
+	Uint32 generation;
+	struct path_tile *tile;
+
+	/* Binary min-heap of open tiles, ordered by 'score'. */
+	int *heap;
+	int heap_len;
+
+	int dest;		/* Tile we are looking for, or -1 to close every tile. */
+	int dest_x, dest_y;	/* Position of 'dest', kept for the heuristic. */
+	bool jump;		/* Use Jump Point Search instead of plain A*. */
+	int expanded;		/* Number of tiles closed so far. */
+};
+
+/* Every thread searches in a scratch state of its own, so that zombies can
+ * search for paths in parallel. The search started by 'path_begin()' keeps
+ * its state in 'resumable' between frames instead. */
+static __thread struct path_state scratch;
+static struct path_state resumable;
+
+/* Flow field leading towards 'flow_dest', holding the next tile to move to
+ * for each tile of a level laid out like 'flow_map', -1 for the destination
+ * itself or 'PATH_UNREACHABLE'. Shared between threads, which may only read
+ * it while others are running. */
+static int *flow;
+static int flow_size;
+static int flow_dest = -1;
+static struct level_map flow_map;
+
+/*
+ * Resize 'ptr' to 'size' bytes, exiting if we have run out of memory.
+ */
+static void *path_realloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (ptr == NULL) {
+		printf("Error: Out of memory for paths!\nExiting...\n");
+		game_terminate(0);
+	}
+
+	return ptr;
+}
+
+/*
+ * Grow the arrays in 's' to fit 'level', starting the generations over if they
+ * had to grow.
+ */
+static void path_fit(struct path_state *s, const struct level_map *level)
+{
+	int size = LEVEL_SIZE(level);
+
+	s->map = *level;
+	if (s->size >= size)
+		return;
+
+	s->tile = path_realloc(s->tile, sizeof(struct path_tile) * size);
+	s->heap = path_realloc(s->heap, sizeof(int) * size);
+
+	memset(s->tile, 0, sizeof(struct path_tile) * size);
+	s->generation = 0;
+	s->size = size;
+}
+
+static bool path_walkable(const struct level_map *level, int x, int y)
+{
+	/* Negative positions wrap around to large ones. */
+	if ((unsigned) x >= (unsigned) level->w || (unsigned) y >= (unsigned) level->h)
+		return false;
+
+	switch (LEVEL_TILE(level, x, y)) {
+	case TILE_WALL:
+	case TILE_UNWALKABLE:
+	case TILE_DOOR:
+		return false;
+	}
+
+	return true;
+}
+
+static int path_heuristic(int x, int y, int dest_x, int dest_y)
+{
+	int dx = abs(x - dest_x), dy = abs(y - dest_y);
+
+	/* Octile distance, which never overestimates on an 8-way grid. */
+	if (dx < dy)
+		return dx * PATH_COST_DIAGONAL + (dy - dx) * PATH_COST_STRAIGHT;
+	else
+		return dy * PATH_COST_DIAGONAL + (dx - dy) * PATH_COST_STRAIGHT;
+}
+
+static bool path_heap_less(struct path_state *s, int a, int b)
+{
+	/* Break ties in favour of the tile closest to the destination. */
+	if (s->tile[a].score == s->tile[b].score)
+		return s->tile[a].cost > s->tile[b].cost;
+
+	return s->tile[a].score < s->tile[b].score;
+}
+
+static void path_heap_up(struct path_state *s, int pos)
+{
+	int tile = s->heap[pos], up;
+
+	while (pos > 0) {
+		up = (pos - 1) / 2;
+		if (!path_heap_less(s, tile, s->heap[up]))
+			break;
+
+		s->heap[pos] = s->heap[up];
+		s->tile[s->heap[pos]].heap_pos = pos;
+		pos = up;
+	}
+
+	s->heap[pos] = tile;
+	s->tile[tile].heap_pos = pos;
+}
+
+static void path_heap_down(struct path_state *s, int pos)
+{
+	int tile = s->heap[pos], down;
+
+	for (;;) {
+		down = pos * 2 + 1;
+		if (down >= s->heap_len)
+			break;
+		if (down + 1 < s->heap_len && path_heap_less(s, s->heap[down + 1], s->heap[down]))
+			down++;
+		if (!path_heap_less(s, s->heap[down], tile))
+			break;
+
+		s->heap[pos] = s->heap[down];
+		s->tile[s->heap[pos]].heap_pos = pos;
+		pos = down;
+	}
+
+	s->heap[pos] = tile;
+	s->tile[tile].heap_pos = pos;
+}
+
+static int path_heap_pop(struct path_state *s)
+{
+	int tile = s->heap[0];
+
+	s->heap_len--;
+	if (s->heap_len > 0) {
+		s->heap[0] = s->heap[s->heap_len];
+		path_heap_down(s, 0);
+	}
+
+	s->tile[tile].heap_pos = -1;
+	return tile;
+}
+
+static int path_sign(int n)
+{
+	return (n > 0) - (n < 0);
+}
+
+/*
+ * Start a new search in 's' from 'src' to 'dest', invalidating the state of
+ * previous searches.
+ */
+static void path_start(struct path_state *s, int src, int dest, bool jump)
+{
+	if (++s->generation == 0) {
+		memset(s->tile, 0, sizeof(struct path_tile) * s->size);
+		s->generation = 1;
+	}
+
+	s->tile[src].seen = s->generation;
+	s->tile[src].cost = 0;
+	s->tile[src].score = 0;
+	s->tile[src].parent = -1;
+	s->heap[0] = src, s->heap_len = 1;
+	s->tile[src].heap_pos = 0;
+
+	s->dest = dest;
+	s->dest_x = (dest == -1) ? -1 : LEVEL_X(&s->map, dest);
+	s->dest_y = (dest == -1) ? -1 : LEVEL_Y(&s->map, dest);
+	s->jump = jump;
+	s->expanded = 0;
+}
+
+/*
+ * Reach 'tile' from 'from' with a path cost of 'g', adding it to the open list
+ * or updating it if it is already there. Scores are estimated towards the
+ * destination, unless there is none.
+ */
+static void path_open(struct path_state *s, int tile, int from, int g)
+{
+	struct path_tile *t = &s->tile[tile];
+
+	if (t->seen != s->generation) {
+		/* Tile is on neither list, add it to the open list. */
+		t->seen = s->generation;
+		t->cost = g;
+		t->score = g;
+		if (s->dest != -1)
+			t->score += path_heuristic(LEVEL_X(&s->map, tile), LEVEL_Y(&s->map, tile), s->dest_x, s->dest_y);
+		t->parent = from;
+		s->heap[s->heap_len] = tile;
+		t->heap_pos = s->heap_len++;
+		path_heap_up(s, t->heap_pos);
+	} else if (t->heap_pos >= 0 && g < t->cost) {
+		/* Tile is open and we have found a cheaper way there. */
+		t->score -= t->cost - g;
+		t->cost = g;
+		t->parent = from;
+		path_heap_up(s, t->heap_pos);
+	}
+}
+
+/*
+ * Copy the path in 's' ending at its destination into 'path' as described for
+ * 'path_search()', following parent tiles back to the source and filling in
+ * any tiles between parents that are further apart.
+ */
+static int path_retrace(struct path_state *s, struct node *path, int size)
+{
+	int i, n, x, y, tile, next;
+	const struct level_map *map = &s->map;
+
+	/* Count the tiles in the path and skip the ones furthest from the
+	 * source if there are more than we have room for. */
+	for (n = 1, tile = s->dest; s->tile[tile].parent != -1; tile = s->tile[tile].parent) {
+		x = abs(LEVEL_X(map, tile) - LEVEL_X(map, s->tile[tile].parent));
+		y = abs(LEVEL_Y(map, tile) - LEVEL_Y(map, s->tile[tile].parent));
+		n += (x > y) ? x : y;
+	}
+
+	n -= size - 1;
+
+	for (i = 1, tile = s->dest; tile != -1; tile = s->tile[tile].parent) {
+		x = LEVEL_X(map, tile), y = LEVEL_Y(map, tile);
+		next = (s->tile[tile].parent == -1) ? tile : s->tile[tile].parent;
+
+		do {
+			if (n-- <= 0) {
+				path[i].x = x;
+				path[i].y = y;
+				i++;
+			}
+
+			x += path_sign(LEVEL_X(map, next) - x);
+			y += path_sign(LEVEL_Y(map, next) - y);
+		} while (LEVEL_INDEX(map, x, y) != next);
+	}
+
+	return i - 1;
+}
+
+/*
+ * Open every neighbour of 'current' we can walk to, as plain A* does.
+ */
+static void path_expand(const struct level_map *level, struct path_state *s, int current)
+{
+	int x, y, cx = LEVEL_X(level, current), cy = LEVEL_Y(level, current);
+
+	for (y = cy - 1; y <= cy + 1; y++)
+	for (x = cx - 1; x <= cx + 1; x++) {
+		if (!path_walkable(level, x, y))
+			continue;
+
+		/* Don't cut through corners. */
+		if (x != cx && y != cy) {
+			if (LEVEL_TILE(level, x, cy) == TILE_WALL)
+				continue;
+			if (LEVEL_TILE(level, cx, y) == TILE_WALL)
+				continue;
+
+			path_open(s, LEVEL_INDEX(level, x, y), current, s->tile[current].cost + PATH_COST_DIAGONAL);
+		} else {
+			path_open(s, LEVEL_INDEX(level, x, y), current, s->tile[current].cost + PATH_COST_STRAIGHT);
+		}
+	}
+}
+
+/*
+ * Returns true if 'x', 'y' is next to a tile that is unwalkable but which
+ * zombies are still allowed to cut past diagonally, unlike walls.
+ */
+static bool path_jump_soft(const struct level_map *level, int x, int y)
+{
+	int i, j, tile;
+	int x1 = (x > 0) ? x - 1 : 0, x2 = (x < level->w - 1) ? x + 1 : x;
+	int y1 = (y > 0) ? y - 1 : 0, y2 = (y < level->h - 1) ? y + 1 : y;
+
+	for (j = y1; j <= y2; j++)
+	for (i = x1; i <= x2; i++) {
+		tile = LEVEL_TILE(level, i, j);
+		if (tile == TILE_UNWALKABLE || tile == TILE_DOOR)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Move from 'x', 'y' in direction 'dx', 'dy' until we find a tile worth adding
+ * to the open list, as per the Jump Point Search algorithm. Returns the tile
+ * found, or -1 if we ran into a wall first.
+ */
+static int path_jump(const struct level_map *level, int x, int y, int dx, int dy, int dest)
+{
+	for (;;) {
+		if (!path_walkable(level, x, y))
+			return -1;
+
+		/* Pruning only holds for tiles surrounded by walls and floors,
+		 * so stop next to anything else and expand it normally. */
+		if (LEVEL_INDEX(level, x, y) == dest || path_jump_soft(level, x, y))
+			return LEVEL_INDEX(level, x, y);
+
+		if (dx != 0 && dy != 0) {
+			/* Moving diagonally, stop if moving straight finds anything. */
+			if (path_jump(level, x + dx, y, dx, 0, dest) != -1 ||
+			    path_jump(level, x, y + dy, 0, dy, dest) != -1)
+				return LEVEL_INDEX(level, x, y);
+
+			/* Don't cut through corners. */
+			if (!path_walkable(level, x + dx, y) || !path_walkable(level, x, y + dy))
+				return -1;
+		} else if (dx != 0) {
+			/* Stop if there are tiles only reachable through this one. */
+			if ((path_walkable(level, x, y - 1) && !path_walkable(level, x - dx, y - 1)) ||
+			    (path_walkable(level, x, y + 1) && !path_walkable(level, x - dx, y + 1)))
+				return LEVEL_INDEX(level, x, y);
+		} else {
+			if ((path_walkable(level, x - 1, y) && !path_walkable(level, x - 1, y - dy)) ||
+			    (path_walkable(level, x + 1, y) && !path_walkable(level, x + 1, y - dy)))
+				return LEVEL_INDEX(level, x, y);
+		}
+
+		x += dx, y += dy;
+	}
+}
+
+/*
+ * Jump from 'current' in direction 'dx', 'dy', opening the tile we land on.
+ */
+static void path_jump_open(const struct level_map *level, struct path_state *s, int current, int dx, int dy)
+{
+	int x = LEVEL_X(level, current), y = LEVEL_Y(level, current);
+	int tile;
+
+	if (!path_walkable(level, x + dx, y + dy))
+		return;
+
+	/* Don't cut through corners. */
+	if (dx != 0 && dy != 0) {
+		if (LEVEL_TILE(level, x + dx, y) == TILE_WALL || LEVEL_TILE(level, x, y + dy) == TILE_WALL)
+			return;
+	}
+
+	tile = path_jump(level, x + dx, y + dy, dx, dy, s->dest);
+	if (tile == -1)
+		return;
+
+	/* Jumps are always straight or diagonal, so the heuristic gives us
+	 * the exact cost of getting there. */
+	path_open(s, tile, current, s->tile[current].cost + path_heuristic(x, y, LEVEL_X(level, tile), LEVEL_Y(level, tile)));
+}
+
+/*
+ * Same as 'path_expand()' but using Jump Point Search, which skips over the
+ * tiles in open areas that plain A* would have to expand one by one.
+ */
+static void path_jump_expand(const struct level_map *level, struct path_state *s, int current)
+{
+	int x = LEVEL_X(level, current), y = LEVEL_Y(level, current);
+	int dx, dy;
+
+	/* Look in every direction from the source or wherever pruning
+	 * doesn't hold, otherwise only where the direction we came from
+	 * allows. */
+	if (s->tile[current].parent == -1 || path_jump_soft(level, x, y)) {
+		for (dy = -1; dy <= 1; dy++)
+		for (dx = -1; dx <= 1; dx++) {
+			if (dx != 0 || dy != 0)
+				path_jump_open(level, s, current, dx, dy);
+		}
+
+		return;
+	}
+
+	dx = path_sign(x - LEVEL_X(level, s->tile[current].parent));
+	dy = path_sign(y - LEVEL_Y(level, s->tile[current].parent));
+
+	if (dx != 0 && dy != 0) {
+		if (path_walkable(level, x, y + dy))
+			path_jump_open(level, s, current, 0, dy);
+		if (path_walkable(level, x + dx, y))
+			path_jump_open(level, s, current, dx, 0);
+		if (path_walkable(level, x, y + dy) && path_walkable(level, x + dx, y))
+			path_jump_open(level, s, current, dx, dy);
+	} else if (dx != 0) {
+		if (path_walkable(level, x + dx, y)) {
+			path_jump_open(level, s, current, dx, 0);
+			if (path_walkable(level, x, y + 1))
+				path_jump_open(level, s, current, dx, 1);
+			if (path_walkable(level, x, y - 1))
+				path_jump_open(level, s, current, dx, -1);
+		}
+		if (path_walkable(level, x, y + 1))
+			path_jump_open(level, s, current, 0, 1);
+		if (path_walkable(level, x, y - 1))
+			path_jump_open(level, s, current, 0, -1);
+	} else {
+		if (path_walkable(level, x, y + dy)) {
+			path_jump_open(level, s, current, 0, dy);
+			if (path_walkable(level, x + 1, y))
+				path_jump_open(level, s, current, 1, dy);
+			if (path_walkable(level, x - 1, y))
+				path_jump_open(level, s, current, -1, dy);
+		}
+		if (path_walkable(level, x + 1, y))
+			path_jump_open(level, s, current, 1, 0);
+		if (path_walkable(level, x - 1, y))
+			path_jump_open(level, s, current, -1, 0);
+	}
+}
+
+/*
+ * Close up to 'budget' tiles of the search in 's', lowest score first, until
+ * its destination is closed, or until every reachable tile is closed if it has
+ * none, in which case this is a plain Dijkstra search. Returns 'PATH_PENDING'
+ * if we ran out of budget first, otherwise true if the search succeeded.
+ */
+static int path_step(const struct level_map *level, struct path_state *s, int budget)
+{
+	int current;
+
+	for (; budget > 0; budget--) {
+		/* Check for dead end. */
+		if (s->heap_len == 0)
+			return s->dest == -1;
+
+		/* Move to the open tile with the lowest score, closing it. */
+		current = path_heap_pop(s);
+		s->expanded++;
+
+		if (current == s->dest)
+			return true;
+
+		if (s->jump)
+			path_jump_expand(level, s, current);
+		else
+			path_expand(level, s, current);
+	}
+
+	return PATH_PENDING;
+}
+
+/*
+ * Returns false if there is no point in searching for a path from 'src_x',
+ * 'src_y' to 'dest_x', 'dest_y'.
+ */
+static bool path_valid(const struct level_map *level, int src_x, int src_y, int dest_x, int dest_y)
+{
+	if (src_x < 0 || src_x >= level->w || src_y < 0 || src_y >= level->h)
+		return false;
+	if (!path_walkable(level, dest_x, dest_y) || (src_x == dest_x && src_y == dest_y))
+		return false;
+
+	return true;
+}
+
+int path_search(const struct level_map *level, int src_x, int src_y, int dest_x, int dest_y,
+		struct node *path, int size)
+{
+	scratch.expanded = 0;
+
+	if (!path_valid(level, src_x, src_y, dest_x, dest_y))
+		return 0;
+
+	path_fit(&scratch, level);
+	path_start(&scratch, LEVEL_INDEX(level, src_x, src_y), LEVEL_INDEX(level, dest_x, dest_y), false);
+	if (path_step(level, &scratch, LEVEL_SIZE(level) + 1) != true)
+		return 0;
+
+	return path_retrace(&scratch, path, size);
+}
+
+int path_jump_search(const struct level_map *level, int src_x, int src_y, int dest_x, int dest_y,
+		     struct node *path, int size)
+{
+	scratch.expanded = 0;
+
+	if (!path_valid(level, src_x, src_y, dest_x, dest_y))
+		return 0;
+
+	path_fit(&scratch, level);
+	path_start(&scratch, LEVEL_INDEX(level, src_x, src_y), LEVEL_INDEX(level, dest_x, dest_y), true);
+	if (path_step(level, &scratch, LEVEL_SIZE(level) + 1) != true)
+		return 0;
+
+	return path_retrace(&scratch, path, size);
+}
+
+bool path_begin(const struct level_map *level, int src_x, int src_y, int dest_x, int dest_y, bool jump)
+{
+	resumable.expanded = 0;
+
+	if (!path_valid(level, src_x, src_y, dest_x, dest_y))
+		return false;
+
+	path_fit(&resumable, level);
+	path_start(&resumable, LEVEL_INDEX(level, src_x, src_y), LEVEL_INDEX(level, dest_x, dest_y), jump);
+	return true;
+}
+
+int path_resume(const struct level_map *level, int *budget, struct node *path, int size)
+{
+	int expanded = resumable.expanded;
+	int found = path_step(level, &resumable, *budget);
+
+	*budget -= resumable.expanded - expanded;
+
+	if (found == PATH_PENDING)
+		return PATH_PENDING;
+	if (!found)
+		return 0;
+
+	return path_retrace(&resumable, path, size);
+}
+
+void path_flow_build(const struct level_map *level, int dest_x, int dest_y)
+{
+	int tile;
+
+	flow_dest = -1;
+
+	if (!path_walkable(level, dest_x, dest_y))
+		return;
+
+	if (flow_size < LEVEL_SIZE(level)) {
+		flow_size = LEVEL_SIZE(level);
+		flow = path_realloc(flow, sizeof(int) * flow_size);
+	}
+
+	/* Search outwards from the destination. Since moves are symmetric, the
+	 * parent of each tile is also its next step towards the destination. */
+	path_fit(&scratch, level);
+	path_start(&scratch, LEVEL_INDEX(level, dest_x, dest_y), -1, false);
+	path_step(level, &scratch, LEVEL_SIZE(level) + 1);
+
+	for (tile = 0; tile < LEVEL_SIZE(level); tile++) {
+		if (scratch.tile[tile].seen == scratch.generation)
+			flow[tile] = scratch.tile[tile].parent;
+		else
+			flow[tile] = PATH_UNREACHABLE;
+	}
+
+	flow_map = *level;
+	flow_dest = LEVEL_INDEX(level, dest_x, dest_y);
+}
+
+void path_flow_reset(void)
+{
+	flow_dest = -1;
+}
+
+bool path_flow_ready(int dest_x, int dest_y)
+{
+	return flow_dest != -1 && flow_dest == LEVEL_INDEX(&flow_map, dest_x, dest_y);
+}
+
+int path_flow_search(int src_x, int src_y, struct node *path, int size)
+{
+	int i, n, tile, src;
+
+	if (flow_dest == -1 || src_x < 0 || src_x >= flow_map.w || src_y < 0 || src_y >= flow_map.h)
+		return 0;
+
+	src = LEVEL_INDEX(&flow_map, src_x, src_y);
+	if (flow[src] == PATH_UNREACHABLE || src == flow_dest)
+		return 0;
+
+	/* Count the nodes between us and the destination, keeping only as
+	 * many as we have room for. */
+	for (n = 0, tile = src; tile != -1; tile = flow[tile])
+		n++;
+	if (n > size - 1)
+		n = size - 1;
+
+	/* Follow the field, filling the path backwards so that it ends up in
+	 * the same order as the one returned by 'path_search()'. */
+	for (i = n, tile = src; i > 0; i--, tile = flow[tile]) {
+		path[i].x = LEVEL_X(&flow_map, tile);
+		path[i].y = LEVEL_Y(&flow_map, tile);
+	}
+
+	return n;
+}
+
+int path_regions(const struct level_map *level, int *region)
+{
+	int x, y, i, j, cx, cy, tile, len, num = 0;
+	int *stack;
+
+	for (i = 0; i < LEVEL_SIZE(level); i++)
+		region[i] = -1;
+
+	stack = path_realloc(NULL, sizeof(int) * LEVEL_SIZE(level));
+
+	/* Flood every region from the first tile we find in it, following the
+	 * same moves as 'path_expand()'. */
+	for (y = 0; y < level->h; y++)
+	for (x = 0; x < level->w; x++) {
+		if (region[LEVEL_INDEX(level, x, y)] != -1 || !path_walkable(level, x, y))
+			continue;
+
+		region[LEVEL_INDEX(level, x, y)] = num;
+		stack[0] = LEVEL_INDEX(level, x, y), len = 1;
+
+		while (len > 0) {
+			tile = stack[--len];
+			cx = LEVEL_X(level, tile), cy = LEVEL_Y(level, tile);
+
+			for (j = cy - 1; j <= cy + 1; j++)
+			for (i = cx - 1; i <= cx + 1; i++) {
+				if (!path_walkable(level, i, j) || region[LEVEL_INDEX(level, i, j)] != -1)
+					continue;
+
+				/* Don't cut through corners. */
+				if (i != cx && j != cy &&
+				    (LEVEL_TILE(level, i, cy) == TILE_WALL || LEVEL_TILE(level, cx, j) == TILE_WALL))
+					continue;
+
+				region[LEVEL_INDEX(level, i, j)] = num;
+				stack[len++] = LEVEL_INDEX(level, i, j);
+			}
+		}
+
+		num++;
+	}
+
+	free(stack);
+
+	return num;
+}
+
+int path_expanded(void)
+{
+	return scratch.expanded;
+}
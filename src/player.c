@@ -7,9 +7,20 @@
 #include "levels.h"
 #include "player.h"
 
+/*
+ * Returns tile 'x', 'y' of the level, treating everything beyond its edges as walls.
+ */
+static char player_tile(struct game_data *game, int x, int y)
+{
+	if (x < 0 || x >= game->level.w || y < 0 || y >= game->level.h)
+		return TILE_WALL;
+
+	return LEVEL_TILE(&game->level, x, y);
+}
+
 void player_move(struct game_data *game)
 {
-	SDL_Rect tmp;				/* Used for collision detection. */
+	SDL_Rect tmp, wall;			/* Used for collision detection. */
 	int move_x, move_y;			/* Used for holding our direction temporarily. */
 	int x, y, i, position = 1;	/* Position of wall relative to player. */
 
@@ -22,28 +33,30 @@ void player_move(struct game_data *game)
 	move_y = (int) (game->player.dir_y * ((float) game->delta_time / 1000.0f));
 
 	for (y = PLAYER_Y - 1; y <= PLAYER_Y + 1; y++)
-	for (x = PLAYER_X - 1; x <= PLAYER_X + 1; x++, position++)
-		switch (game->level[y][x]) {
+	for (x = PLAYER_X - 1; x <= PLAYER_X + 1; x++, position++) {
+		/* Nothing beyond the edges to run into, the player is kept inside below. */
+		if (x < 0 || x >= game->level.w || y < 0 || y >= game->level.h)
+			continue;
+
+		switch (LEVEL_TILE(&game->level, x, y)) {
 		case TILE_EXIT:
 			/* You have cleared this stage, congratulations! */
-			if (level_collision(game->player.rect, game->wall[y][x])) {
-				graphics_entity_clear(game, &(game->player));
+			if (level_collision(game->player.rect, level_wall(game, x, y)))
 				game->level_cleared = true;
-			}
 			break;
 		case TILE_GOODIE:
-			/* Find which goodie in the 'goodies' array we're colliding with. */
-			for (i = 0; i < game->num_goodies; i++)
-				if ((game->goodie[i].rect.x / TILE_SIZE == x) && (game->goodie[i].rect.y / TILE_SIZE == y))
-					break;
+			/* Once we collide with a goodie on this tile, remove it from
+			 * the level, and mark where it was for the world to be drawn
+			 * again without it. That moves another goodie into its place,
+			 * so look through the tile again from the start. */
+			for (i = level_goodie_first(game, x, y); i != -1; ) {
+				if (!level_collision(game->player.rect, game->goodie.rect[i])) {
+					i = game->goodie.cell_next[i];
+					continue;
+				}
 
-			/* Once we collide with the goodie, clear the goodie, rearrange
-			 * the goodies array and reduce the number of goodies in the level. */
-			if (level_collision(game->player.rect, game->goodie[i].rect)) {
-				graphics_entity_clear(game, (struct pc *) &(game->goodie[i]));
-				game->goodie[i] = game->goodie[game->num_goodies - 1];
-				game->level[y][x] = TILE_FLOOR;
-				game->num_goodies--;
+				graphics_dirty_add(game, game->goodie.iso[i], GOODIE_W, GOODIE_H);
+				level_goodie_remove(game, i);
 				game->score += 100;
 				/* Give us 1 life every 10000 score. */
 				if (game->score / game->score_scale == 1) {
@@ -53,49 +66,54 @@ void player_move(struct game_data *game)
 				/* If we have removed all goodies, open the door. */
 				if (game->num_goodies == 0)
 					level_unlock(game);
+
+				i = level_goodie_first(game, x, y);
 			}
 			break;
-		case TILE_DOOR: /* Treat the closed door as a wall and fall through. */
-		case TILE_WALL:
+		default: /* Walls and closed doors keep the player out. */
+			if (!level_solid(game, x, y, SOLID_PLAYER))
+				break;
+
+			wall = level_wall(game, x, y);
 			tmp = game->player.rect;
 			if (move_x < 0) {
 				switch (position) {
 				case 1: /* Do not move through walls to the top-left diagonally. */
 					tmp.x += move_x, tmp.y += move_y;
-					if ((level_collision(tmp, game->wall[y][x])) &&
-					    (game->level[y + 1][x] != TILE_WALL) && (move_y < 0))
-						move_y = (game->wall[y][x].y + game->wall[y][x].h) - game->player.rect.y;
+					if ((level_collision(tmp, wall)) &&
+					    (player_tile(game, x, y + 1) != TILE_WALL) && (move_y < 0))
+						move_y = (wall.y + wall.h) - game->player.rect.y;
 					break;
 				case 4: /* Do not move through walls to the left. */
 					tmp.x += move_x;
-					if (level_collision(tmp, game->wall[y][x]))
-						move_x = (game->wall[y][x].x + game->wall[y][x].w) - game->player.rect.x;
+					if (level_collision(tmp, wall))
+						move_x = (wall.x + wall.w) - game->player.rect.x;
 					break;
 				case 7: /* Do not move through walls to the bottom-left from the right. */
 					tmp.x += move_x;
-					if ((level_collision(tmp, game->wall[y][x])) &&
-					    (game->wall[y][x].y < tmp.y + tmp.h))
-						move_x = (game->wall[y][x].x + game->wall[y][x].w) - game->player.rect.x;
+					if ((level_collision(tmp, wall)) &&
+					    (wall.y < tmp.y + tmp.h))
+						move_x = (wall.x + wall.w) - game->player.rect.x;
 					break;
 				}
 			} else if (move_x > 0) {
 				switch (position) {
 				case 3: /* Do not move through walls to the top-right diagonally. */
 					tmp.x += move_x, tmp.y += move_y;
-					if ((level_collision(tmp, game->wall[y][x])) &&
-					    (game->level[y + 1][x] != TILE_WALL) && (move_y < 0))
-						move_y = (game->wall[y][x].y + game->wall[y][x].h) - game->player.rect.y;
+					if ((level_collision(tmp, wall)) &&
+					    (player_tile(game, x, y + 1) != TILE_WALL) && (move_y < 0))
+						move_y = (wall.y + wall.h) - game->player.rect.y;
 					break;
 				case 6: /* Do not move through walls to the right. */
 					tmp.x += move_x;
-					if (level_collision(tmp, game->wall[y][x]))
-						move_x = game->wall[y][x].x - (game->player.rect.x + game->player.rect.w);
+					if (level_collision(tmp, wall))
+						move_x = wall.x - (game->player.rect.x + game->player.rect.w);
 					break;
 				case 9: /* Do not move through walls to the bottom-right from the left. */
 					tmp.x += move_x;
-					if ((level_collision(tmp, game->wall[y][x])) &&
-					    (game->wall[y][x].y < tmp.y + tmp.h))
-						move_x = game->wall[y][x].x - (game->player.rect.x + game->player.rect.w);
+					if ((level_collision(tmp, wall)) &&
+					    (wall.y < tmp.y + tmp.h))
+						move_x = wall.x - (game->player.rect.x + game->player.rect.w);
 					break;
 				}
 			}
@@ -105,60 +123,59 @@ void player_move(struct game_data *game)
 				switch (position) {
 				case 2: /* Do not move through walls to the top. */
 					tmp.y += move_y;
-					if (level_collision(tmp, game->wall[y][x]))
-						move_y = (game->wall[y][x].y + game->wall[y][x].h) - game->player.rect.y;
+					if (level_collision(tmp, wall))
+						move_y = (wall.y + wall.h) - game->player.rect.y;
 					break;
 				case 3: /* Do not move through walls to the top-right from the bottom. */
 					tmp.y += move_y;
-					if ((level_collision(tmp, game->wall[y][x])) &&
-					    (game->wall[y][x].x < tmp.x + tmp.w))
-						move_y = (game->wall[y][x].y + game->wall[y][x].h) - game->player.rect.y;
+					if ((level_collision(tmp, wall)) &&
+					    (wall.x < tmp.x + tmp.w))
+						move_y = (wall.y + wall.h) - game->player.rect.y;
 					break;
 				}
 			} else if (move_y > 0) {
 				switch (position) {
 				case 7: /* Do not move through walls to the bottom-left diagonally. */
 					tmp.x += move_x, tmp.y += move_y;
-					if ((level_collision(tmp, game->wall[y][x])) &&
-					    (game->level[y][x + 1] != TILE_WALL) && (move_x < 0))
-						move_x = (game->wall[y][x].x + game->wall[y][x].w) - game->player.rect.x;
+					if ((level_collision(tmp, wall)) &&
+					    (player_tile(game, x + 1, y) != TILE_WALL) && (move_x < 0))
+						move_x = (wall.x + wall.w) - game->player.rect.x;
 					break;
 				case 8: /* Do not move through walls to the bottom. */
 					tmp.y += move_y;
-					if (level_collision(tmp, game->wall[y][x]))
-						move_y = game->wall[y][x].y - (game->player.rect.y + game->player.rect.h);
+					if (level_collision(tmp, wall))
+						move_y = wall.y - (game->player.rect.y + game->player.rect.h);
 					break;
 				case 9: /* Do not move through walls to the bottom-right from the top. */
 					tmp.y += move_y;
-					if ((level_collision(tmp, game->wall[y][x])) &&
-					    (game->wall[y][x].x < tmp.x + tmp.w)) {
-						move_y = game->wall[y][x].y - (game->player.rect.y + game->player.rect.h);
+					if ((level_collision(tmp, wall)) &&
+					    (wall.x < tmp.x + tmp.w)) {
+						move_y = wall.y - (game->player.rect.y + game->player.rect.h);
 						break;
 					}
 					/* Do not move through walls to the bottom-right diagonally. */
 					tmp.x += move_x;
-					if ((level_collision(tmp, game->wall[y][x])) &&
-					    (game->level[y][x - 1] != TILE_WALL) && (move_x > 0))
-						move_x = game->wall[y][x].x - (game->player.rect.x + game->player.rect.w);
+					if ((level_collision(tmp, wall)) &&
+					    (player_tile(game, x - 1, y) != TILE_WALL) && (move_x > 0))
+						move_x = wall.x - (game->player.rect.x + game->player.rect.w);
 					break;
 				}
 			}
 			break;
 		}
+	}
 
 	/* Do not move over screen edges. */
 	tmp = game->player.rect, tmp.x += move_x;
 	if ((tmp.x <= 0) && (move_x < 0))
 		move_x = -(game->player.rect.x);
-	else if ((tmp.x + tmp.w >= LEVEL_W * TILE_SIZE) && move_x > 0)
-		move_x = (LEVEL_W * TILE_SIZE) - (game->player.rect.x + game->player.rect.w);
-
-	graphics_entity_clear(game, &(game->player));
+	else if ((tmp.x + tmp.w >= game->level.w * TILE_SIZE) && move_x > 0)
+		move_x = (game->level.w * TILE_SIZE) - (game->player.rect.x + game->player.rect.w);
 
 	game->player.rect.x += move_x;
 	game->player.rect.y += move_y;
 
-	graphics_iso_convert(&(game->player));
+	game->player.iso = graphics_iso_convert(game, game->player.rect);
 
 	player_camera_follow(game);
 }
@@ -166,17 +183,17 @@ void player_move(struct game_data *game)
 void player_camera_follow(struct game_data *game)
 {
 	/* Keep the camera centered over our player. */
-	game->camera.x = (game->player.iso_x + ENTITY_W / 2) - game->screen_w / 2;
-	game->camera.y = (game->player.iso_y + ENTITY_H / 2) - game->screen_h / 2;
+	game->camera.x = (game->player.iso.x + ENTITY_W / 2) - game->screen_w / 2;
+	game->camera.y = (game->player.iso.y + ENTITY_H / 2) - game->screen_h / 2;
 
 	/* Do not go out of bounds. */
 	if (game->camera.x < 0)
 		game->camera.x = 0;
-	else if (game->camera.x > (LEVEL_W * (TILE_SIZE / 2) + LEVEL_H * (TILE_SIZE / 2)) - game->camera.w)
-		game->camera.x = (LEVEL_W * (TILE_SIZE / 2) + LEVEL_H * (TILE_SIZE / 2)) - game->camera.w;
+	else if (game->camera.x > (game->level.w * (TILE_SIZE / 2) + game->level.h * (TILE_SIZE / 2)) - game->camera.w)
+		game->camera.x = (game->level.w * (TILE_SIZE / 2) + game->level.h * (TILE_SIZE / 2)) - game->camera.w;
 
 	if (game->camera.y < 0)
 		game->camera.y = 0;
-	else if (game->camera.y > (LEVEL_W * (TILE_SIZE / 4) + LEVEL_H * (TILE_SIZE / 4) + (TILE_SIZE / 2)) - game->camera.h)
-		game->camera.y = (LEVEL_W * (TILE_SIZE / 4) + LEVEL_H * (TILE_SIZE / 4) + (TILE_SIZE / 2)) - game->camera.h;
+	else if (game->camera.y > (game->level.w * (TILE_SIZE / 4) + game->level.h * (TILE_SIZE / 4) + (TILE_SIZE / 2)) - game->camera.h)
+		game->camera.y = (game->level.w * (TILE_SIZE / 4) + game->level.h * (TILE_SIZE / 4) + (TILE_SIZE / 2)) - game->camera.h;
 }
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <SDL.h>
+
+#include "game.h"
+#include "render.h"
+
+/* Pixel format of the backends without a display, with alpha in the top byte
+ * for images that have any. */
+#define RENDER_RMASK 0x00ff0000
+#define RENDER_GMASK 0x0000ff00
+#define RENDER_BMASK 0x000000ff
+#define RENDER_AMASK 0xff000000
+
+static SDL_Surface *render_sdl_screen(int w, int h, bool fullscreen)
+{
+	SDL_Surface *screen;
+
+	/* The screen is only updated where it changed, which needs it to keep what
+	 * was last drawn to it, so it can't be double buffered. */
+	if (fullscreen)
+		screen = SDL_SetVideoMode(w, h, SCREEN_DEPTH, SDL_SWSURFACE | SDL_FULLSCREEN);
+	else
+		screen = SDL_SetVideoMode(w, h, SCREEN_DEPTH, SDL_SWSURFACE);
+
+	if (screen == NULL)
+		return NULL;
+
+	SDL_WM_SetCaption("Spooky Maze", "spooky-maze");
+	SDL_ShowCursor(SDL_DISABLE);
+
+	return screen;
+}
+
+static SDL_Surface *render_sdl_surface(int w, int h)
+{
+	SDL_Surface *tmp, *optimized;
+
+	/* Initialize temporary surface. */
+	tmp = SDL_CreateRGBSurface(SDL_HWSURFACE | SDL_SRCCOLORKEY, w, h, SCREEN_DEPTH, 0, 0, 0, 0);
+	if (tmp == NULL)
+		return NULL;
+
+	/* Optimize surface for rendering. */
+	optimized = SDL_DisplayFormat(tmp);
+	SDL_FreeSurface(tmp);
+
+	return optimized;
+}
+
+static SDL_Surface *render_sdl_image(SDL_Surface *image)
+{
+	SDL_Surface *optimized;
+
+	/* Optimize image and set alpha channel. */
+	optimized = SDL_DisplayFormatAlpha(image);
+	if (optimized != NULL)
+		SDL_SetColorKey(optimized, SDL_RLEACCEL, optimized->format->colorkey);
+
+	return optimized;
+}
+
+static void render_sdl_present(SDL_Surface *screen, int num_rects, SDL_Rect *rect)
+{
+	if (rect == NULL)
+		SDL_Flip(screen);
+	else
+		SDL_UpdateRects(screen, num_rects, rect);
+}
+
+static SDL_Surface *render_buffer_screen(int w, int h, bool fullscreen)
+{
+	/* Without a display there is no telling fullscreen apart. */
+	return SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 32, RENDER_RMASK, RENDER_GMASK, RENDER_BMASK, 0);
+}
+
+static SDL_Surface *render_buffer_surface(int w, int h)
+{
+	return SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 32, RENDER_RMASK, RENDER_GMASK, RENDER_BMASK, 0);
+}
+
+static SDL_Surface *render_buffer_image(SDL_Surface *image)
+{
+	SDL_Surface *format, *converted;
+
+	/* A surface of the format wanted is the easiest way to come by it. */
+	format = SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, 32, RENDER_RMASK, RENDER_GMASK, RENDER_BMASK, RENDER_AMASK);
+	if (format == NULL)
+		return NULL;
+
+	converted = SDL_ConvertSurface(image, format->format, SDL_SWSURFACE | SDL_SRCALPHA);
+	SDL_FreeSurface(format);
+
+	return converted;
+}
+
+static void render_buffer_present(SDL_Surface *screen, int num_rects, SDL_Rect *rect)
+{
+	/* The frame stays in 'screen' for whoever wants to look at it. */
+}
+
+static void render_blit(SDL_Surface *image, SDL_Rect *src, SDL_Surface *surface, SDL_Rect *dst)
+{
+	SDL_BlitSurface(image, src, surface, dst);
+}
+
+static void render_fill(SDL_Surface *surface, SDL_Rect *dst, Uint32 color)
+{
+	SDL_FillRect(surface, dst, color);
+}
+
+static void render_null_blit(SDL_Surface *image, SDL_Rect *src, SDL_Surface *surface, SDL_Rect *dst)
+{
+}
+
+static void render_null_fill(SDL_Surface *surface, SDL_Rect *dst, Uint32 color)
+{
+}
+
+const struct render_backend render_backends[RENDER_BACKENDS] = {
+	[RENDER_SDL] = {
+		.name = "sdl",
+		.subsystems = SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_TIMER,
+		.display = true,
+
+		.screen_init = render_sdl_screen,
+		.surface_init = render_sdl_surface,
+		.image_convert = render_sdl_image,
+
+		.level_draw = render_blit,
+		.level_fill = render_fill,
+		.sprite_draw = render_blit,
+		.text_draw = render_blit,
+		.copy = render_blit,
+		.present = render_sdl_present,
+	},
+
+	[RENDER_BUFFER] = {
+		.name = "buffer",
+		.subsystems = SDL_INIT_TIMER,
+		.display = false,
+
+		.screen_init = render_buffer_screen,
+		.surface_init = render_buffer_surface,
+		.image_convert = render_buffer_image,
+
+		.level_draw = render_blit,
+		.level_fill = render_fill,
+		.sprite_draw = render_blit,
+		.text_draw = render_blit,
+		.copy = render_blit,
+		.present = render_buffer_present,
+	},
+
+	/* Surfaces are still made, so that everything is laid out as usual, but
+	 * nothing is ever drawn to them. */
+	[RENDER_NULL] = {
+		.name = "null",
+		.subsystems = SDL_INIT_TIMER,
+		.display = false,
+
+		.screen_init = render_buffer_screen,
+		.surface_init = render_buffer_surface,
+		.image_convert = render_buffer_image,
+
+		.level_draw = render_null_blit,
+		.level_fill = render_null_fill,
+		.sprite_draw = render_null_blit,
+		.text_draw = render_null_blit,
+		.copy = render_null_blit,
+		.present = render_buffer_present,
+	},
+};
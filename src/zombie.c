@@ -1,520 +1,807 @@
 #include <stdio.h>
+#include <string.h>
 #include <SDL.h>
 
 #include "game.h"
 #include "graphics.h"
 #include "levels.h"
+#include "path.h"
 #include "player.h"
 #include "zombie.h"
 
-int zombie_path_search(struct npc *zombie, char level[LEVEL_H][LEVEL_W])
+#define ZOMBIE_BATCH 16 /* Number of zombies a thread takes at a time to think about. */
+#define ZOMBIE_TRIES 8  /* Random tiles around us a zombie tries before wandering anywhere in its region. */
+
+/* Worker threads helping the main thread with 'zombie_think()'. Workers wait on
+ * 'start', take batches of zombies from 'next' until there are none left, then
+ * post 'done'. */
+static struct {
+	int num_workers;
+	SDL_sem *start, *done;
+	SDL_mutex *lock;	/* Protects 'next'. */
+	int next;		/* First zombie nobody has taken yet. */
+	struct game_data *game;
+} zombie_pool;
+
+void zombie_grid_build(struct game_data *game)
 {
-	int x, y;
-	int position, i;
-	int t = 0, c = 0;
-	struct list *tmp;
-	struct list *current_node;
-	struct list open[SEARCH_DEPTH];
-	struct list closed[SEARCH_DEPTH];
-
-	/* First, add our zombie to the closed list. */
-	closed[c].x = zombie->rect.x / TILE_SIZE;
-	closed[c].y = zombie->rect.y / TILE_SIZE;
-	closed[c].g = 0;
-	closed[c].parent = NULL;
-	current_node = &closed[c];
-	c++;
-
-	/* Then, search all adjacent squares and add them to the open list if suitable. */
-	for (;;) {
-		position = 1;
-		for (y = current_node->y - 1; y <= current_node->y + 1; y++)
-		for (x = current_node->x - 1; x <= current_node->x + 1; x++, position++) {
-			/* Check if the node is a wall. */
-			if ((level[y][x] == TILE_WALL) || (level[y][x] == TILE_UNWALKABLE) || (level[y][x] == TILE_DOOR))
-				continue;
+	int i;
 
-			/* Don't cut through corners. */
-			switch (position) {
-				case 1:
-					if (level[current_node->y][current_node->x - 1] == TILE_WALL)
-						goto next_node; /* Go to the end of the loop. */
-					else if (level[current_node->y - 1][current_node->x] == TILE_WALL)
-						goto next_node;
-					break;
-				case 3:
-					if (level[current_node->y][current_node->x + 1] == TILE_WALL)
-						goto next_node;
-					else if (level[current_node->y - 1][current_node->x] == TILE_WALL)
-						goto next_node;
-					break;
-				case 7:
-					if (level[current_node->y][current_node->x - 1] == TILE_WALL)
-						goto next_node;
-					else if (level[current_node->y + 1][current_node->x] == TILE_WALL)
-						goto next_node;
-					break;
-				case 9:
-					if (level[current_node->y][current_node->x + 1] == TILE_WALL)
-						goto next_node;
-					else if (level[current_node->y + 1][current_node->x] == TILE_WALL)
-						goto next_node;
-					break;
-				default:
-					break;
-			}
+	for (i = 0; i < LEVEL_SIZE(&game->level); i++)
+		game->zombie_grid[i] = -1;
 
-			/* Check if we have matched our destination. */
-			if (x == zombie->dest_x && y == zombie->dest_y) {
-				closed[c].x = x, closed[c].y = y;
-				closed[c].parent = current_node;
-				goto dest_found; /* Go to the (near) end of the function. */
-			}
+	for (i = 0; i < game->num_zombies; i++) {
+		game->zombie.cell[i] = LEVEL_INDEX(&game->level, ZOMBIE_X(i), ZOMBIE_Y(i));
+		game->zombie.cell_next[i] = game->zombie_grid[game->zombie.cell[i]];
+		game->zombie_grid[game->zombie.cell[i]] = i;
+	}
+}
 
-			/* Check if the node is in the closed list. */
-			for (i = c - 1; i >= 0; i--)
-				if (x == closed[i].x && y == closed[i].y)
-					goto next_node;
-
-			/* Check if the node is in the open list. */
-			for (i = t - 1; i >= 0; i--)
-				if (x == open[i].x && y == open[i].y && !open[i].dropped) {
-					if ((current_node->g + (position % 2) ? 14 : 10) < open[i].g) {
-						open[i].g = current_node->g + (position % 2) ? 14 : 10;
-						open[i].f = open[i].g + open[i].h;
-						open[i].parent = current_node;
-						goto next_node;
-					} else {
-						goto next_node;
-					}
-				}
+int zombie_grid_first(struct game_data *game, int x, int y)
+{
+	if (x < 0 || x >= game->level.w || y < 0 || y >= game->level.h)
+		return -1;
 
-			/* Node is not a wall and is on neither list, add to the open list. */
-			open[t].x = x, open[t].y = y;
-			open[t].g = current_node->g + (position % 2) ? 14 : 10;
-			open[t].h = (abs(open[t].x - zombie->dest_x) + abs(open[t].y - zombie->dest_y)) * 10;
-			open[t].f = open[t].g + open[t].h;
-			open[t].parent = current_node;
-			open[t].dropped = false;
-
-			/* If we have exceeded our search depth, set current adjacent
-			 * node as destination and move there instead. */
-			if (t < SEARCH_DEPTH - 1) {
-				t++;
-			} else {
-				closed[c].x = x, closed[c].y = y;
-				closed[c].parent = current_node;
-				goto dest_found;
-			}
+	return game->zombie_grid[LEVEL_INDEX(&game->level, x, y)];
+}
 
-			/* End of loop. */
-			next_node:;
-		}
+/*
+ * Move zombie 'i' to the tile it is standing on in 'game->zombie_grid', if it
+ * has changed tiles since it was last filed.
+ */
+static void zombie_grid_update(struct game_data *game, int i)
+{
+	int *n;
+	int cell = LEVEL_INDEX(&game->level, ZOMBIE_X(i), ZOMBIE_Y(i));
 
-		/* Search open list for node with the lowest 'f' and move to it. */
-		tmp = NULL;
-		for (i = t - 1; i > 0; i--) {
-			if (!open[i].dropped) {
-				if (tmp == NULL)
-					tmp = &open[i];
-				else if (open[i].f < tmp->f)
-					tmp = &open[i];
-			}
-		}
+	if (game->zombie.cell[i] == cell)
+		return;
 
-		/* Check for dead end. */
-		if (tmp == NULL) 
-			return 0;
-		else
-			current_node = tmp;
+	/* Unlink from the old tile. */
+	n = &game->zombie_grid[game->zombie.cell[i]];
+	while (*n != i)
+		n = &game->zombie.cell_next[*n];
+	*n = game->zombie.cell_next[i];
+
+	/* Link into the new one. */
+	game->zombie.cell[i] = cell;
+	game->zombie.cell_next[i] = game->zombie_grid[cell];
+	game->zombie_grid[cell] = i;
+}
+
+/*
+ * Returns true if any zombie has caught up with the player.
+ */
+static bool zombie_player_caught(struct game_data *game)
+{
+	int x, y, n;
 
-		/* Drop current node from the open list and add it to the closed list. */
-		current_node->dropped = true;
-		closed[c] = *current_node;
-		c++;
+	for (y = PLAYER_Y - 1; y <= PLAYER_Y + 1; y++)
+	for (x = PLAYER_X - 1; x <= PLAYER_X + 1; x++)
+	for (n = zombie_grid_first(game, x, y); n != -1; n = game->zombie.cell_next[n]) {
+		if (level_collision(game->zombie.rect[n], game->player.rect))
+			return true;
 	}
 
-	/* We have reached our destination! */
-	dest_found:
+	return false;
+}
 
-	/* Retrace the path from the end, following parent nodes until we
-	 * reach our zombie. Copy X/Y coordinates into the 'path' struct. */
-	zombie->path[1].x = closed[c].x;
-	zombie->path[1].y = closed[c].y;
-	tmp = closed[c].parent;
+/*
+ * Returns the number of nodes to walk in the 'n' node path stored for zombie 'i'.
+ */
+static int zombie_path_start(struct game_data *game, int i, int n)
+{
+	struct node *path = ZOMBIE_PATH(i);
 
-	for (i = 2; tmp != NULL; i++) {
-		zombie->path[i].x = tmp->x;
-		zombie->path[i].y = tmp->y;
-		tmp = tmp->parent;
-	}
+	if (n == 0)
+		return 0;
 
 	/* Return the number of nodes in the path, starting from the node next to
 	 * our current position unless certain conditions are met and we need to
 	 * center on our current position first. */
-	if ((zombie->path[i - 2].x < zombie->path[i - 1].x) &&
-	    (zombie->rect.y > (zombie->path[i - 1].y * TILE_SIZE)) &&
-	    (level[zombie->path[i - 1].y + 1][zombie->path[i - 1].x - 1] == TILE_WALL))
-		return i - 1;
-	if ((zombie->path[i - 2].y < zombie->path[i - 1].y) &&
-	    (zombie->rect.x > (zombie->path[i - 1].x * TILE_SIZE)) &&
-	    (level[zombie->path[i - 1].y - 1][zombie->path[i - 1].x + 1] == TILE_WALL))
-		return i - 1;
-	if ((zombie->path[i - 2].x > zombie->path[i - 1].x) &&
-	    (zombie->rect.y > (zombie->path[i - 1].y * TILE_SIZE)) &&
-	    (level[zombie->path[i - 1].y + 1][zombie->path[i - 1].x + 1] == TILE_WALL))
-		return i - 1;
-	if ((zombie->path[i - 2].y > zombie->path[i - 1].y) &&
-	    (zombie->rect.x > (zombie->path[i - 1].x * TILE_SIZE)) &&
-	    (level[zombie->path[i - 1].y + 1][zombie->path[i - 1].x + 1] == TILE_WALL))
-		return i - 1;
-
-	return i - 2;
+	if ((path[n - 1].x < path[n].x) &&
+	    (game->zombie.rect[i].y > (path[n].y * TILE_SIZE)) &&
+	    (LEVEL_TILE(&game->level, path[n].x - 1, path[n].y + 1) == TILE_WALL))
+		return n;
+	if ((path[n - 1].y < path[n].y) &&
+	    (game->zombie.rect[i].x > (path[n].x * TILE_SIZE)) &&
+	    (LEVEL_TILE(&game->level, path[n].x + 1, path[n].y - 1) == TILE_WALL))
+		return n;
+	if ((path[n - 1].x > path[n].x) &&
+	    (game->zombie.rect[i].y > (path[n].y * TILE_SIZE)) &&
+	    (LEVEL_TILE(&game->level, path[n].x + 1, path[n].y + 1) == TILE_WALL))
+		return n;
+	if ((path[n - 1].y > path[n].y) &&
+	    (game->zombie.rect[i].x > (path[n].x * TILE_SIZE)) &&
+	    (LEVEL_TILE(&game->level, path[n].x + 1, path[n].y + 1) == TILE_WALL))
+		return n;
+
+	return n - 1;
 }
 
-void zombie_move(struct game_data *game)
+int zombie_path_search(struct game_data *game, int i)
 {
-	SDL_Rect tmp;
-	int x, y, i, n;
-	int move_x, move_y;
+	int n;
 
-	/* Protect against incorrect delta-time readings */
-	if (game->delta_time > 100)
+	if (game->pathfinder == PATH_JUMP)
+		n = path_jump_search(&game->level, ZOMBIE_X(i), ZOMBIE_Y(i),
+				     game->zombie.dest[i].x, game->zombie.dest[i].y, ZOMBIE_PATH(i), PATH_SIZE);
+	else
+		n = path_search(&game->level, ZOMBIE_X(i), ZOMBIE_Y(i),
+				game->zombie.dest[i].x, game->zombie.dest[i].y, ZOMBIE_PATH(i), PATH_SIZE);
+
+	return zombie_path_start(game, i, n);
+}
+
+int zombie_path_chase(struct game_data *game, int i)
+{
+	int n;
+
+	/* Zombies heading for a tile the field doesn't lead to need a search of their own. */
+	if (!path_flow_ready(game->zombie.dest[i].x, game->zombie.dest[i].y))
+		return zombie_path_search(game, i);
+
+	n = path_flow_search(ZOMBIE_X(i), ZOMBIE_Y(i), ZOMBIE_PATH(i), PATH_SIZE);
+
+	return zombie_path_start(game, i, n);
+}
+
+/*
+ * Returns the next number in the random sequence of zombie 'i'. Each zombie
+ * keeps its own, so that the numbers it gets do not depend on the order in
+ * which zombies think, or on which thread.
+ */
+static int zombie_rand(struct game_data *game, int i)
+{
+	Uint32 x = game->zombie.seed[i];
+
+	x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+	game->zombie.seed[i] = x;
+
+	return x >> 1;
+}
+
+/*
+ * Returns the tile zombie 'i' will be standing on once it has walked its path.
+ */
+static struct node zombie_path_end(struct game_data *game, int i)
+{
+	struct node end;
+
+	if (game->zombie.num_nodes[i] > 0)
+		return ZOMBIE_PATH(i)[1];
+
+	end.x = ZOMBIE_X(i), end.y = ZOMBIE_Y(i);
+	return end;
+}
+
+/*
+ * Call off the path zombie 'i' is waiting for, if any.
+ */
+static void zombie_path_cancel(struct game_data *game, int i)
+{
+	if (game->zombie.request[i] != ZOMBIE_IDLE) {
+		game->zombie.request[i] = ZOMBIE_IDLE;
+		game->zombie.ticket[i]++;
+	}
+}
+
+/*
+ * Pick a destination for zombie 'i' up to 10 squares away from where its
+ * current path ends, and ask for a path there.
+ */
+static void zombie_wander(struct game_data *game, int i)
+{
+	int x, y, r, n, try;
+	struct node end = zombie_path_end(game, i);
+	bool bias = game->zombie.num_nodes[i] == 0 && game->zombie.dest[i].x > 0 && game->zombie.dest[i].y > 0;
+
+	if (game->zombie.request[i] != ZOMBIE_IDLE)
 		return;
 
-	/* Scale the zombie speed depending on the frame-rate */
-	move_x = (int) (ZOMBIE_SPEED * ((float) game->delta_time / 1000.0f));
-	move_y = (int) (ZOMBIE_SPEED * ((float) game->delta_time / 1000.0f));
+	/* Only pick tiles we can actually walk to from where our path ends. */
+	r = game->region[LEVEL_INDEX(&game->level, end.x, end.y)];
+
+	for (try = 0; try < ZOMBIE_TRIES; try++) {
+		/* Be biased toward pre-existing destinations, used for chasing
+		 * the player after losing sight. */
+		if (bias) {
+			if (game->zombie.dest[i].x - ZOMBIE_X(i) > 0)
+				x = (zombie_rand(game, i) % 10);
+			else if (game->zombie.dest[i].x - ZOMBIE_X(i) < 0)
+				x = (zombie_rand(game, i) % 10) * -1;
+			else
+				x = (zombie_rand(game, i) % 20) - 10;
+
+			if (game->zombie.dest[i].y - ZOMBIE_Y(i) > 0)
+				y = (zombie_rand(game, i) % 10);
+			else if (game->zombie.dest[i].y - ZOMBIE_Y(i) < 0)
+				y = (zombie_rand(game, i) % 10) * -1;
+			else
+				y = (zombie_rand(game, i) % 20) - 10;
+		} else {
+			x = (zombie_rand(game, i) % 20) - 10, y = (zombie_rand(game, i) % 20) - 10;
+		}
 
-	for (i = 0; i < game->num_zombies; i++) {
-		graphics_entity_clear(game, (struct pc *) &(ZOMBIE(i)));
-
-		/* 
-		 * Chase our player if found closer than 5 tiles away.
-		 */
-		if (abs(PLAYER_X - ZOMBIE_X(i)) <= 5 && abs(PLAYER_Y - ZOMBIE_Y(i)) <= 5) {
-			/* Check if we have collided with the player. */
-			if (abs(PLAYER_X - ZOMBIE_X(i)) <= 1 && abs(PLAYER_Y - ZOMBIE_Y(i)) <= 1)
-				if (level_collision(ZOMBIE(i).rect, game->player.rect)) {
-					game->player.dead = true;
+		/* Try again without bias until we find a floor tile. */
+		bias = false;
+
+		if ((end.x + x < 0) || (end.x + x >= game->level.w) || 
+		    (end.y + y < 0) || (end.y + y >= game->level.h))
+			continue;
+
+		if (LEVEL_TILE(&game->level, end.x + x, end.y + y) == TILE_FLOOR &&
+		    (r == -1 || game->region[LEVEL_INDEX(&game->level, end.x + x, end.y + y)] == r)) {
+			game->zombie.want[i].x = end.x + x;
+			game->zombie.want[i].y = end.y + y;
+			game->zombie.request[i] = ZOMBIE_ASKING;
+			return;
+		}
+	}
+
+	/* Nothing reachable nearby, so pick any floor tile in our region. Tiles
+	 * taken by goodies since the list was built are skipped until next frame. */
+	if (r == -1)
+		return;
+
+	n = game->region_first[r + 1] - game->region_first[r];
+	if (n == 0)
+		return;
+
+	game->zombie.want[i] = game->region_tiles[game->region_first[r] + zombie_rand(game, i) % n];
+	if (LEVEL_TILE(&game->level, game->zombie.want[i].x, game->zombie.want[i].y) == TILE_FLOOR)
+		game->zombie.request[i] = ZOMBIE_ASKING;
+}
+
+/*
+ * Returns true if zombie 'i' should walk straight towards the player, rather
+ * than following a path.
+ */
+static bool zombie_hunting(struct game_data *game, int i)
+{
+	return (abs(PLAYER_X - ZOMBIE_X(i)) <= LEVEL_SIGHT && abs(PLAYER_Y - ZOMBIE_Y(i)) <= LEVEL_SIGHT) &&
+	       (game->zombie.num_nodes[i] == 0) && (game->zombie.request[i] == ZOMBIE_IDLE) &&
+	       (LEVEL_TILE(&game->level, PLAYER_X, PLAYER_Y) == TILE_FLOOR) &&
+	       (game->zombie.dest[i].x > 0) && (game->zombie.dest[i].y > 0);
+}
+
+/*
+ * Decide where zombie 'i' is heading next, asking for a path there if it needs
+ * one. This only reads the level, the player and zombie 'i', and only writes
+ * to zombie 'i', so zombies may think in any order and on any thread.
+ */
+static void zombie_think(struct game_data *game, int i)
+{
+	/* 
+	 * Chase our player if found closer than 5 tiles away.
+	 */
+	if (abs(PLAYER_X - ZOMBIE_X(i)) <= LEVEL_SIGHT && abs(PLAYER_Y - ZOMBIE_Y(i)) <= LEVEL_SIGHT) {
+		/* Recalculate line of sight if the player has moved from the destination node. */
+		if (((game->zombie.dest[i].x != PLAYER_X) || (game->zombie.dest[i].y != PLAYER_Y)) &&
+		    (LEVEL_TILE(&game->level, PLAYER_X, PLAYER_Y) == TILE_FLOOR)) {
+			if (level_sight(game, PLAYER_X, PLAYER_Y, ZOMBIE_X(i), ZOMBIE_Y(i))) {
+				zombie_path_cancel(game, i);
+				game->zombie.dest[i].x = PLAYER_X;
+				game->zombie.dest[i].y = PLAYER_Y;
+				game->zombie.num_nodes[i] = 0;
+			/* We reached the player's last known position and found nothing. */
+			} else if ((game->zombie.num_nodes[i] == 0) &&
+			            (ZOMBIE_X(i) == game->zombie.dest[i].x) &&
+			            (ZOMBIE_Y(i) == game->zombie.dest[i].y)) {
+				game->zombie.dest[i].x = 0, game->zombie.dest[i].y = 0;
+				zombie_wander(game, i);
+				return;
+			/* Move to last known location if player is out of sight,
+			 * through the flow field if the player was last seen there. */
+			} else if ((game->zombie.num_nodes[i] == 0) && (game->zombie.request[i] == ZOMBIE_IDLE) &&
+				     (game->zombie.dest[i].x > 0) &&
+				     (game->zombie.dest[i].y > 0)) {
+				/* The field leads elsewhere, so queue a search like any other. */
+				if (!path_flow_ready(game->zombie.dest[i].x, game->zombie.dest[i].y)) {
+					game->zombie.want[i] = game->zombie.dest[i];
+					game->zombie.request[i] = ZOMBIE_ASKING;
 					return;
 				}
 
-			/* Recalculate line of sight if the player has moved from the destination node. */
-			if (((ZOMBIE(i).dest_x != PLAYER_X) || (ZOMBIE(i).dest_y != PLAYER_Y)) &&
-			    (game->level[PLAYER_Y][PLAYER_X] == TILE_FLOOR)) {
-				if (level_tile_visible(PLAYER_X, PLAYER_Y, ZOMBIE_X(i), ZOMBIE_Y(i), game->level)) {
-					ZOMBIE(i).dest_x = PLAYER_X;
-					ZOMBIE(i).dest_y = PLAYER_Y;
-					ZOMBIE(i).num_nodes = 0;
-				/* We reached the player's last known position and found nothing. */
-				} else if ((ZOMBIE(i).num_nodes == 0) &&
-				            (ZOMBIE_X(i) == ZOMBIE(i).dest_x) &&
-				            (ZOMBIE_Y(i) == ZOMBIE(i).dest_y)) {
-					ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-					goto random;
-				/* Move to last known location if player is out of sight. */
-				} else if ((ZOMBIE(i).num_nodes == 0) &&
-					     (ZOMBIE(i).dest_x > 0) &&
-					     (ZOMBIE(i).dest_y > 0)) {
-					ZOMBIE(i).num_nodes = zombie_path_search(&ZOMBIE(i), game->level);
-
-					/* Set a random destination if we can't reach our
-					 * player, otherwise move to the chosen destination. */
-					if (ZOMBIE(i).num_nodes == 0)
-						goto random;
-					else
-						goto move;
-				}
+				game->zombie.num_nodes[i] = zombie_path_chase(game, i);
+
+				/* Set a random destination if we can't reach our player. */
+				if (game->zombie.num_nodes[i] == 0)
+					zombie_wander(game, i);
+				return;
 			}
+		}
 
-			if ((ZOMBIE(i).num_nodes == 0) && (game->level[PLAYER_Y][PLAYER_X] == TILE_FLOOR) &&
-			     (ZOMBIE(i).dest_x > 0) && (ZOMBIE(i).dest_y > 0)) {
-				/* Reset X and Y movement speed if zeroed out */
-				if (move_x == 0)
-					move_x = (int) (ZOMBIE_SPEED * ((float) game->delta_time / 1000.0f));
-				if (move_y == 0)
-					move_y = (int) (ZOMBIE_SPEED * ((float) game->delta_time / 1000.0f));
-
-				tmp = ZOMBIE(i).rect;
-
-				/* Check for collision in the X axis. */
-				if (ZOMBIE(i).rect.x < ZOMBIE(i).dest_x * TILE_SIZE) {
-					tmp.x += move_x;
-
-					/* Do not move through walls to the right. */
-					switch (game->level[ZOMBIE_Y(i)][ZOMBIE_X(i) + 1]) {
-					case TILE_WALL:
-					case TILE_UNWALKABLE:
-						if (level_collision(tmp, game->wall[ZOMBIE_Y(i)][ZOMBIE_X(i) + 1]))
-							move_x = game->wall[ZOMBIE_Y(i)][ZOMBIE_X(i) + 1].x - (ZOMBIE(i).rect.x + ENTITY_W);
-					}
-
-					/* Do not move through walls to the bottom right. */
-					switch (game->level[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) + 1]) {
-					case TILE_WALL:
-					case TILE_UNWALKABLE:
-						if (level_collision(tmp, game->wall[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) + 1]))
-							move_x = game->wall[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) + 1].x - (ZOMBIE(i).rect.x + ENTITY_W);
-					}
-
-					if (tmp.x > ZOMBIE(i).dest_x * TILE_SIZE)
-						move_x = tmp.x - (ZOMBIE(i).dest_x * TILE_SIZE);
-				} else if (ZOMBIE(i).rect.x > ZOMBIE(i).dest_x * TILE_SIZE) {
-					tmp.x -= move_x;
-
-					/* Do not move through walls to the left. */
-					switch (game->level[ZOMBIE_Y(i)][ZOMBIE_X(i) - 1]) {
-					case TILE_WALL:
-					case TILE_UNWALKABLE:
-						if (level_collision(tmp, game->wall[ZOMBIE_Y(i)][ZOMBIE_X(i) - 1]))
-							move_x = ZOMBIE(i).rect.x - (game->wall[ZOMBIE_Y(i)][ZOMBIE_X(i) - 1].x + TILE_SIZE);
-					}
-
-					/* Do not move through walls to the bottom left. */
-					switch (game->level[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) - 1]) {
-					case TILE_WALL:
-					case TILE_UNWALKABLE:
-						if (level_collision(tmp, game->wall[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) - 1]))
-							move_x = ZOMBIE(i).rect.x - (game->wall[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) - 1].x + TILE_SIZE);
-					}
-
-					if (tmp.x < ZOMBIE(i).dest_x * TILE_SIZE)
-						move_x = (ZOMBIE(i).dest_x * TILE_SIZE) - tmp.x;
-				}
+		if ((game->zombie.num_nodes[i] == 0) && (game->zombie.request[i] == ZOMBIE_IDLE) &&
+		    !zombie_hunting(game, i)) {
+			game->zombie.dest[i].x = 0, game->zombie.dest[i].y = 0;
+			zombie_wander(game, i);
+		}
+	/* 
+	 * Ask for a new destination +/- 10 squares away once we are about to
+	 * run out of path, so that we can keep walking while it is searched for.
+	 */
+	} else if (game->zombie.num_nodes[i] <= ZOMBIE_LOOKAHEAD) {
+		zombie_wander(game, i);
+	}
+}
 
-				/* Check for collision on the Y axis. */
-				if (ZOMBIE(i).rect.y < ZOMBIE(i).dest_y * TILE_SIZE) {
-					tmp.y += move_y;
-
-					/* Do not move through walls to the bottom. */
-					switch (game->level[ZOMBIE_Y(i) + 1][ZOMBIE_X(i)]) {
-					case TILE_WALL:
-					case TILE_UNWALKABLE:
-						if (level_collision(tmp, game->wall[ZOMBIE_Y(i) + 1][ZOMBIE_X(i)]))
-							move_y = game->wall[ZOMBIE_Y(i) + 1][ZOMBIE_X(i)].y - (ZOMBIE(i).rect.y + ENTITY_H);
-					}
-
-					/* Do not move through walls to the bottom right. */
-					switch (game->level[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) + 1]) {
-					case TILE_WALL:
-					case TILE_UNWALKABLE:
-						if (level_collision(tmp, game->wall[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) + 1]))
-							move_y = game->wall[ZOMBIE_Y(i) + 1][ZOMBIE_X(i) + 1].y - (ZOMBIE(i).rect.y + ENTITY_H);
-					}
-
-					if (tmp.y > ZOMBIE(i).dest_y * TILE_SIZE)
-						move_y = tmp.y - (ZOMBIE(i).dest_y * TILE_SIZE);
-				} else if (ZOMBIE(i).rect.y > ZOMBIE(i).dest_y * TILE_SIZE) {
-					tmp.y -= move_y;
-
-					/* Do not move through walls to the top. */
-					switch (game->level[ZOMBIE_Y(i) - 1][ZOMBIE_X(i)]) {
-					case TILE_WALL:
-					case TILE_UNWALKABLE:
-						if (level_collision(tmp, game->wall[ZOMBIE_Y(i) - 1][ZOMBIE_X(i)]))
-							move_y = ZOMBIE(i).rect.y - (game->wall[ZOMBIE_Y(i) - 1][ZOMBIE_X(i)].y + TILE_SIZE);
-					}
-
-					/* Do not move through walls to the top right. */
-					switch (game->level[ZOMBIE_Y(i) - 1][ZOMBIE_X(i) + 1]) {
-					case TILE_WALL:
-					case TILE_UNWALKABLE:
-						if (level_collision(tmp, game->wall[ZOMBIE_Y(i) - 1][ZOMBIE_X(i) + 1]))
-							move_y = ZOMBIE(i).rect.y - (game->wall[ZOMBIE_Y(i) - 1][ZOMBIE_X(i) + 1].y + TILE_SIZE);
-					}
-
-					if (tmp.y < ZOMBIE(i).dest_y * TILE_SIZE)
-						move_y = (ZOMBIE(i).dest_y * TILE_SIZE) - tmp.y;
-				}
+/*
+ * Walk zombie 'i' straight towards the player at 'speed' pixels, without
+ * going through walls or other zombies.
+ */
+static void zombie_walk(struct game_data *game, int i, int speed)
+{
+	SDL_Rect tmp, wall;
+	int x, y, n;
+	int move_x = speed, move_y = speed;
 
-				/* Do not move in space occupied by other zombies. */
-				for (n = 0; n < game->num_zombies; n++) {
-					if (n != i) {
-						if (level_collision(tmp, game->zombie[n].rect)) {
-							/* Stop moving if other zombie is in path */
-							if ((ZOMBIE(i).rect.x > game->zombie[n].rect.x + game->zombie[n].rect.w) &&
-							    (tmp.x < ZOMBIE(i).rect.x))
-								move_x = 0;
-							else if ((ZOMBIE(i).rect.x + ZOMBIE(i).rect.w < game->zombie[n].rect.x) &&
-								  (tmp.x > ZOMBIE(i).rect.x))
-								move_x = 0;
-							if ((ZOMBIE(i).rect.y > game->zombie[n].rect.y + game->zombie[n].rect.h) &&
-							    (tmp.y < ZOMBIE(i).rect.y))
-								move_y = 0;
-							else if ((ZOMBIE(i).rect.y + ZOMBIE(i).rect.h < game->zombie[n].rect.y) &&
-								  (tmp.y > ZOMBIE(i).rect.y))
-								move_y = 0;
-						}
-					}
-				}
+	tmp = game->zombie.rect[i];
+
+	/* Check for collision in the X axis. */
+	if (game->zombie.rect[i].x < game->zombie.dest[i].x * TILE_SIZE) {
+		tmp.x += move_x;
+
+		/* Do not move through walls to the right. */
+		if (level_solid(game, ZOMBIE_X(i) + 1, ZOMBIE_Y(i), SOLID_ZOMBIE)) {
+			wall = level_wall(game, ZOMBIE_X(i) + 1, ZOMBIE_Y(i));
+			if (level_collision(tmp, wall))
+				move_x = wall.x - (game->zombie.rect[i].x + ENTITY_W);
+		}
+
+		/* Do not move through walls to the bottom right. */
+		if (level_solid(game, ZOMBIE_X(i) + 1, ZOMBIE_Y(i) + 1, SOLID_ZOMBIE)) {
+			wall = level_wall(game, ZOMBIE_X(i) + 1, ZOMBIE_Y(i) + 1);
+			if (level_collision(tmp, wall))
+				move_x = wall.x - (game->zombie.rect[i].x + ENTITY_W);
+		}
+
+		if (tmp.x > game->zombie.dest[i].x * TILE_SIZE)
+			move_x = tmp.x - (game->zombie.dest[i].x * TILE_SIZE);
+	} else if (game->zombie.rect[i].x > game->zombie.dest[i].x * TILE_SIZE) {
+		tmp.x -= move_x;
+
+		/* Do not move through walls to the left. */
+		if (level_solid(game, ZOMBIE_X(i) - 1, ZOMBIE_Y(i), SOLID_ZOMBIE)) {
+			wall = level_wall(game, ZOMBIE_X(i) - 1, ZOMBIE_Y(i));
+			if (level_collision(tmp, wall))
+				move_x = game->zombie.rect[i].x - (wall.x + TILE_SIZE);
+		}
+
+		/* Do not move through walls to the bottom left. */
+		if (level_solid(game, ZOMBIE_X(i) - 1, ZOMBIE_Y(i) + 1, SOLID_ZOMBIE)) {
+			wall = level_wall(game, ZOMBIE_X(i) - 1, ZOMBIE_Y(i) + 1);
+			if (level_collision(tmp, wall))
+				move_x = game->zombie.rect[i].x - (wall.x + TILE_SIZE);
+		}
+
+		if (tmp.x < game->zombie.dest[i].x * TILE_SIZE)
+			move_x = (game->zombie.dest[i].x * TILE_SIZE) - tmp.x;
+	}
+
+	/* Check for collision on the Y axis. */
+	if (game->zombie.rect[i].y < game->zombie.dest[i].y * TILE_SIZE) {
+		tmp.y += move_y;
+
+		/* Do not move through walls to the bottom. */
+		if (level_solid(game, ZOMBIE_X(i), ZOMBIE_Y(i) + 1, SOLID_ZOMBIE)) {
+			wall = level_wall(game, ZOMBIE_X(i), ZOMBIE_Y(i) + 1);
+			if (level_collision(tmp, wall))
+				move_y = wall.y - (game->zombie.rect[i].y + ENTITY_H);
+		}
+
+		/* Do not move through walls to the bottom right. */
+		if (level_solid(game, ZOMBIE_X(i) + 1, ZOMBIE_Y(i) + 1, SOLID_ZOMBIE)) {
+			wall = level_wall(game, ZOMBIE_X(i) + 1, ZOMBIE_Y(i) + 1);
+			if (level_collision(tmp, wall))
+				move_y = wall.y - (game->zombie.rect[i].y + ENTITY_H);
+		}
+
+		if (tmp.y > game->zombie.dest[i].y * TILE_SIZE)
+			move_y = tmp.y - (game->zombie.dest[i].y * TILE_SIZE);
+	} else if (game->zombie.rect[i].y > game->zombie.dest[i].y * TILE_SIZE) {
+		tmp.y -= move_y;
+
+		/* Do not move through walls to the top. */
+		if (level_solid(game, ZOMBIE_X(i), ZOMBIE_Y(i) - 1, SOLID_ZOMBIE)) {
+			wall = level_wall(game, ZOMBIE_X(i), ZOMBIE_Y(i) - 1);
+			if (level_collision(tmp, wall))
+				move_y = game->zombie.rect[i].y - (wall.y + TILE_SIZE);
+		}
+
+		/* Do not move through walls to the top right. */
+		if (level_solid(game, ZOMBIE_X(i) + 1, ZOMBIE_Y(i) - 1, SOLID_ZOMBIE)) {
+			wall = level_wall(game, ZOMBIE_X(i) + 1, ZOMBIE_Y(i) - 1);
+			if (level_collision(tmp, wall))
+				move_y = game->zombie.rect[i].y - (wall.y + TILE_SIZE);
+		}
+
+		if (tmp.y < game->zombie.dest[i].y * TILE_SIZE)
+			move_y = (game->zombie.dest[i].y * TILE_SIZE) - tmp.y;
+	}
 
-				/* Move towards destination. */
-				if (ZOMBIE(i).rect.x < ZOMBIE(i).dest_x * TILE_SIZE)
-					ZOMBIE(i).rect.x += move_x;
-				else if (ZOMBIE(i).rect.x > ZOMBIE(i).dest_x * TILE_SIZE)
-					ZOMBIE(i).rect.x -= move_x;
-
-				if (ZOMBIE(i).rect.y < ZOMBIE(i).dest_y * TILE_SIZE)
-					ZOMBIE(i).rect.y += move_y;
-				else if (ZOMBIE(i).rect.y > ZOMBIE(i).dest_y * TILE_SIZE)
-					ZOMBIE(i).rect.y -= move_y;
-
-				graphics_iso_convert((struct pc *) &(ZOMBIE(i)));
-			} else if (ZOMBIE(i).num_nodes == 0) {
-				ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-				goto random;
-			} else {
-				goto move;
+	/* Do not move in space occupied by other zombies. */
+	for (y = ZOMBIE_Y(i) - 1; y <= ZOMBIE_Y(i) + 1; y++)
+	for (x = ZOMBIE_X(i) - 1; x <= ZOMBIE_X(i) + 1; x++)
+	for (n = zombie_grid_first(game, x, y); n != -1; n = game->zombie.cell_next[n]) {
+		if (n != i) {
+			if (level_collision(tmp, game->zombie.rect[n])) {
+				/* Stop moving if other zombie is in path */
+				if ((game->zombie.rect[i].x > game->zombie.rect[n].x + game->zombie.rect[n].w) &&
+				    (tmp.x < game->zombie.rect[i].x))
+					move_x = 0;
+				else if ((game->zombie.rect[i].x + game->zombie.rect[i].w < game->zombie.rect[n].x) &&
+					  (tmp.x > game->zombie.rect[i].x))
+					move_x = 0;
+				if ((game->zombie.rect[i].y > game->zombie.rect[n].y + game->zombie.rect[n].h) &&
+				    (tmp.y < game->zombie.rect[i].y))
+					move_y = 0;
+				else if ((game->zombie.rect[i].y + game->zombie.rect[i].h < game->zombie.rect[n].y) &&
+					  (tmp.y > game->zombie.rect[i].y))
+					move_y = 0;
 			}
-		/* 
-		 * Start moving if we do have a destination set.
-		 */
-		} else if (ZOMBIE(i).num_nodes > 0) {
-			move:
-
-			/* Check if we have reached the next node. */
-			if ((ZOMBIE_NODE(i).x * TILE_SIZE == ZOMBIE(i).rect.x) &&
-			    (ZOMBIE_NODE(i).y * TILE_SIZE == ZOMBIE(i).rect.y)) {
-				ZOMBIE(i).num_nodes--;
-				if (ZOMBIE(i).num_nodes == 0) {
-					ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-					continue;
+		}
+	}
+
+	/* Move towards destination. */
+	if (game->zombie.rect[i].x < game->zombie.dest[i].x * TILE_SIZE)
+		game->zombie.rect[i].x += move_x;
+	else if (game->zombie.rect[i].x > game->zombie.dest[i].x * TILE_SIZE)
+		game->zombie.rect[i].x -= move_x;
+
+	if (game->zombie.rect[i].y < game->zombie.dest[i].y * TILE_SIZE)
+		game->zombie.rect[i].y += move_y;
+	else if (game->zombie.rect[i].y > game->zombie.dest[i].y * TILE_SIZE)
+		game->zombie.rect[i].y -= move_y;
+
+	game->zombie.iso[i] = graphics_iso_convert(game, game->zombie.rect[i]);
+	zombie_grid_update(game, i);
+}
+
+/*
+ * Walk zombie 'i' along its path at 'speed' pixels, giving up on the path if
+ * it gets stuck against another zombie.
+ */
+static void zombie_follow(struct game_data *game, int i, int speed)
+{
+	SDL_Rect tmp;
+	int x, y, n;
+	int move_x = speed, move_y = speed;
+
+	/* Check if we have reached the next node. */
+	if ((ZOMBIE_NODE(i).x * TILE_SIZE == game->zombie.rect[i].x) &&
+	    (ZOMBIE_NODE(i).y * TILE_SIZE == game->zombie.rect[i].y)) {
+		game->zombie.num_nodes[i]--;
+		if (game->zombie.num_nodes[i] == 0) {
+			game->zombie.dest[i].x = 0, game->zombie.dest[i].y = 0;
+			return;
+		}
+	}
+
+	/* Calculate movement direction */
+	tmp = game->zombie.rect[i];
+	if (ZOMBIE_NODE(i).x * TILE_SIZE < game->zombie.rect[i].x)
+		tmp.x -= move_x;
+	else if (ZOMBIE_NODE(i).x * TILE_SIZE > game->zombie.rect[i].x)
+		tmp.x += move_x;
+	if (ZOMBIE_NODE(i).y * TILE_SIZE < game->zombie.rect[i].y)
+		tmp.y -= move_y;
+	else if (ZOMBIE_NODE(i).y * TILE_SIZE > game->zombie.rect[i].y)
+		tmp.y += move_y;
+
+	/* Do not move in space occupied by other zombies. */
+	for (y = ZOMBIE_Y(i) - 1; y <= ZOMBIE_Y(i) + 1; y++)
+	for (x = ZOMBIE_X(i) - 1; x <= ZOMBIE_X(i) + 1; x++)
+	for (n = zombie_grid_first(game, x, y); n != -1; n = game->zombie.cell_next[n]) {
+		if (n != i) {
+			if (level_collision(tmp, game->zombie.rect[n])) {
+				/* Pick a new path next frame if stuck against one another. */
+				if ((game->zombie.rect[i].x + game->zombie.rect[i].w < game->zombie.rect[n].x) &&
+				    (game->zombie.rect[i].x < ZOMBIE_NODE(i).x * TILE_SIZE) &&
+				    (game->zombie.rect[n].x > ZOMBIE_NODE(n).x * TILE_SIZE)) {
+					game->zombie.dest[i].x = 0, game->zombie.dest[i].y = 0;
+					game->zombie.num_nodes[i] = 0;
+					zombie_path_cancel(game, i);
+					return;
+				} else if ((game->zombie.rect[i].x + game->zombie.rect[i].w > game->zombie.rect[n].x) &&
+				    (game->zombie.rect[i].x > ZOMBIE_NODE(i).x * TILE_SIZE) &&
+				    (game->zombie.rect[n].x < ZOMBIE_NODE(n).x * TILE_SIZE)) {
+					game->zombie.dest[i].x = 0, game->zombie.dest[i].y = 0;
+					game->zombie.num_nodes[i] = 0;
+					zombie_path_cancel(game, i);
+					return;
 				}
-			}
 
-			/* Reset X and Y movement speed if zeroed out */
-			if (move_x == 0)
-				move_x = (int) (ZOMBIE_SPEED * ((float) game->delta_time / 1000.0f));
-			if (move_y == 0)
-				move_y = (int) (ZOMBIE_SPEED * ((float) game->delta_time / 1000.0f));
-
-			/* Calculate movement direction */
-			tmp = ZOMBIE(i).rect;
-			if (ZOMBIE_NODE(i).x * TILE_SIZE < ZOMBIE(i).rect.x)
-				tmp.x -= move_x;
-			else if (ZOMBIE_NODE(i).x * TILE_SIZE > ZOMBIE(i).rect.x)
-				tmp.x += move_x;
-			if (ZOMBIE_NODE(i).y * TILE_SIZE < ZOMBIE(i).rect.y)
-				tmp.y -= move_y;
-			else if (ZOMBIE_NODE(i).y * TILE_SIZE > ZOMBIE(i).rect.y)
-				tmp.y += move_y;
-
-			/* Do not move in space occupied by other zombies. */
-			for (n = 0; n < game->num_zombies; n++) {
-				if (n != i) {
-					if (level_collision(tmp, game->zombie[n].rect)) {
-						/* Recalculate path if stuck against one another. */
-						if ((ZOMBIE(i).rect.x + ZOMBIE(i).rect.w < ZOMBIE(n).rect.x) &&
-						    (ZOMBIE(i).rect.x < ZOMBIE_NODE(i).x * TILE_SIZE) &&
-						    (ZOMBIE(n).rect.x > ZOMBIE_NODE(n).x * TILE_SIZE)) {
-							ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-							goto random;
-						} else if ((ZOMBIE(i).rect.x + ZOMBIE(i).rect.w > ZOMBIE(n).rect.x) &&
-						    (ZOMBIE(i).rect.x > ZOMBIE_NODE(i).x * TILE_SIZE) &&
-						    (ZOMBIE(n).rect.x < ZOMBIE_NODE(n).x * TILE_SIZE)) {
-							ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-							goto random;
-						}
-
-						if ((ZOMBIE(i).rect.y + ZOMBIE(i).rect.h < ZOMBIE(n).rect.y) &&
-						    (ZOMBIE(i).rect.y < ZOMBIE_NODE(i).y * TILE_SIZE) &&
-						    (ZOMBIE(n).rect.y > ZOMBIE_NODE(n).y * TILE_SIZE)) {
-							ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-							goto random;
-						} else if ((ZOMBIE(i).rect.y + ZOMBIE(i).rect.h > ZOMBIE(n).rect.y) &&
-						    (ZOMBIE(i).rect.y > ZOMBIE_NODE(i).y * TILE_SIZE) &&
-						    (ZOMBIE(n).rect.y < ZOMBIE_NODE(n).y * TILE_SIZE)) {
-							ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-							goto random;
-						}
-
-						/* Stop moving if other zombie is in path */
-						if ((ZOMBIE(i).rect.x > game->zombie[n].rect.x + game->zombie[n].rect.w) &&
-						    (tmp.x < ZOMBIE(i).rect.x))
-							move_x = 0;
-						else if ((ZOMBIE(i).rect.x + ZOMBIE(i).rect.w < game->zombie[n].rect.x) &&
-							  (tmp.x > ZOMBIE(i).rect.x))
-							move_x = 0;
-						if ((ZOMBIE(i).rect.y > game->zombie[n].rect.y + game->zombie[n].rect.h) &&
-						    (tmp.y < ZOMBIE(i).rect.y))
-							move_y = 0;
-						else if ((ZOMBIE(i).rect.y + ZOMBIE(i).rect.h < game->zombie[n].rect.y) &&
-							  (tmp.y > ZOMBIE(i).rect.y))
-							move_y = 0;
-					}
+				if ((game->zombie.rect[i].y + game->zombie.rect[i].h < game->zombie.rect[n].y) &&
+				    (game->zombie.rect[i].y < ZOMBIE_NODE(i).y * TILE_SIZE) &&
+				    (game->zombie.rect[n].y > ZOMBIE_NODE(n).y * TILE_SIZE)) {
+					game->zombie.dest[i].x = 0, game->zombie.dest[i].y = 0;
+					game->zombie.num_nodes[i] = 0;
+					zombie_path_cancel(game, i);
+					return;
+				} else if ((game->zombie.rect[i].y + game->zombie.rect[i].h > game->zombie.rect[n].y) &&
+				    (game->zombie.rect[i].y > ZOMBIE_NODE(i).y * TILE_SIZE) &&
+				    (game->zombie.rect[n].y < ZOMBIE_NODE(n).y * TILE_SIZE)) {
+					game->zombie.dest[i].x = 0, game->zombie.dest[i].y = 0;
+					game->zombie.num_nodes[i] = 0;
+					zombie_path_cancel(game, i);
+					return;
 				}
-			}
 
-			/* Move our zombie towards the next node in our path */
-			if (ZOMBIE_NODE(i).x * TILE_SIZE < ZOMBIE(i).rect.x) {
-				if (tmp.x < ZOMBIE_NODE(i).x * TILE_SIZE)
-					ZOMBIE(i).rect.x -= ZOMBIE(i).rect.x - (ZOMBIE_NODE(i).x * TILE_SIZE);
-				else
-					ZOMBIE(i).rect.x -= move_x;
-			} else if (ZOMBIE_NODE(i).x * TILE_SIZE > ZOMBIE(i).rect.x) {
-				if (tmp.x > ZOMBIE_NODE(i).x * TILE_SIZE)
-					ZOMBIE(i).rect.x += (ZOMBIE_NODE(i).x * TILE_SIZE) - ZOMBIE(i).rect.x;
-				else
-					ZOMBIE(i).rect.x += move_x;
+				/* Stop moving if other zombie is in path */
+				if ((game->zombie.rect[i].x > game->zombie.rect[n].x + game->zombie.rect[n].w) &&
+				    (tmp.x < game->zombie.rect[i].x))
+					move_x = 0;
+				else if ((game->zombie.rect[i].x + game->zombie.rect[i].w < game->zombie.rect[n].x) &&
+					  (tmp.x > game->zombie.rect[i].x))
+					move_x = 0;
+				if ((game->zombie.rect[i].y > game->zombie.rect[n].y + game->zombie.rect[n].h) &&
+				    (tmp.y < game->zombie.rect[i].y))
+					move_y = 0;
+				else if ((game->zombie.rect[i].y + game->zombie.rect[i].h < game->zombie.rect[n].y) &&
+					  (tmp.y > game->zombie.rect[i].y))
+					move_y = 0;
 			}
+		}
+	}
 
-			if (ZOMBIE_NODE(i).y * TILE_SIZE < ZOMBIE(i).rect.y) {
-				if (tmp.y < ZOMBIE_NODE(i).y * TILE_SIZE)
-					ZOMBIE(i).rect.y -= ZOMBIE(i).rect.y - (ZOMBIE_NODE(i).y * TILE_SIZE);
-				else
-					ZOMBIE(i).rect.y -= move_y;
-			} else if (ZOMBIE_NODE(i).y * TILE_SIZE > ZOMBIE(i).rect.y) {
-				if (tmp.y > ZOMBIE_NODE(i).y * TILE_SIZE)
-					ZOMBIE(i).rect.y += (ZOMBIE_NODE(i).y * TILE_SIZE) - ZOMBIE(i).rect.y;
-				else
-					ZOMBIE(i).rect.y += move_y;
-			}
+	/* Move our zombie towards the next node in our path */
+	if (ZOMBIE_NODE(i).x * TILE_SIZE < game->zombie.rect[i].x) {
+		if (tmp.x < ZOMBIE_NODE(i).x * TILE_SIZE)
+			game->zombie.rect[i].x -= game->zombie.rect[i].x - (ZOMBIE_NODE(i).x * TILE_SIZE);
+		else
+			game->zombie.rect[i].x -= move_x;
+	} else if (ZOMBIE_NODE(i).x * TILE_SIZE > game->zombie.rect[i].x) {
+		if (tmp.x > ZOMBIE_NODE(i).x * TILE_SIZE)
+			game->zombie.rect[i].x += (ZOMBIE_NODE(i).x * TILE_SIZE) - game->zombie.rect[i].x;
+		else
+			game->zombie.rect[i].x += move_x;
+	}
 
-			graphics_iso_convert((struct pc *) &(ZOMBIE(i)));
-		/* 
-		 * We don't have a destination set, so let's set one +/- 10 squares away. 
-		 */
-		} else {
-			random:
-
-			/* Be biased toward pre-existing destinations, used for chasing
-			 * the player after losing sight. */
-			if (ZOMBIE(i).dest_x > 0 && ZOMBIE(i).dest_y > 0) {
-				if (ZOMBIE(i).dest_x - ZOMBIE_X(i) > 0)
-					x = (rand() % 10);
-				else if (ZOMBIE(i).dest_x - ZOMBIE_X(i) < 0)
-					x = (rand() % 10) * -1;
-				else
-					x = (rand() % 20) - 10;
-
-				if (ZOMBIE(i).dest_y - ZOMBIE_Y(i) > 0)
-					y = (rand() % 10);
-				else if (ZOMBIE(i).dest_y - ZOMBIE_Y(i) < 0)
-					y = (rand() % 10) * -1;
-				else
-					y = (rand() % 20) - 10;
-			} else {
-				x = (rand() % 20) - 10, y = (rand() % 20) - 10;
+	if (ZOMBIE_NODE(i).y * TILE_SIZE < game->zombie.rect[i].y) {
+		if (tmp.y < ZOMBIE_NODE(i).y * TILE_SIZE)
+			game->zombie.rect[i].y -= game->zombie.rect[i].y - (ZOMBIE_NODE(i).y * TILE_SIZE);
+		else
+			game->zombie.rect[i].y -= move_y;
+	} else if (ZOMBIE_NODE(i).y * TILE_SIZE > game->zombie.rect[i].y) {
+		if (tmp.y > ZOMBIE_NODE(i).y * TILE_SIZE)
+			game->zombie.rect[i].y += (ZOMBIE_NODE(i).y * TILE_SIZE) - game->zombie.rect[i].y;
+		else
+			game->zombie.rect[i].y += move_y;
+	}
+
+	game->zombie.iso[i] = graphics_iso_convert(game, game->zombie.rect[i]);
+	zombie_grid_update(game, i);
+}
+
+void zombie_queue_clear(struct game_data *game)
+{
+	game->path_queue.head = game->path_queue.len = 0;
+	game->path_queue.busy = false;
+}
+
+/*
+ * Drop the first request in the path queue.
+ */
+static void zombie_queue_pop(struct game_data *game)
+{
+	game->path_queue.head++;
+	game->path_queue.len--;
+	game->path_queue.busy = false;
+}
+
+/*
+ * Queue up the paths zombies asked for while thinking, in zombie order so that
+ * they come out the same however many threads did the thinking.
+ */
+static void zombie_queue_push(struct game_data *game)
+{
+	struct path_queue *queue = &game->path_queue;
+	struct path_request *request;
+	int i, n, len;
+
+	for (i = 0; i < game->num_zombies; i++) {
+		if (game->zombie.request[i] != ZOMBIE_ASKING)
+			continue;
+
+		/* Out of room at the end, so move the requests still wanted to the
+		 * front. Each zombie waits for one path at most, so this always
+		 * leaves room for another. */
+		if (queue->head + queue->len == queue->size) {
+			for (n = 0, len = 0; n < queue->len; n++) {
+				request = &queue->request[queue->head + n];
+				if (game->zombie.ticket[request->zombie] == request->ticket)
+					queue->request[len++] = *request;
+				else if (n == 0)
+					queue->busy = false;
 			}
 
-			if ((ZOMBIE_X(i) + x < 0) || (ZOMBIE_X(i) + x > LEVEL_W) || 
-			    (ZOMBIE_Y(i) + y < 0) || (ZOMBIE_Y(i) + y > LEVEL_W)) {
-				ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-				i--;
-			} else if (game->level[ZOMBIE_Y(i) + y][ZOMBIE_X(i) + x] == TILE_FLOOR) {
-				ZOMBIE(i).dest_x = ZOMBIE_X(i) + x;
-				ZOMBIE(i).dest_y = ZOMBIE_Y(i) + y;
-
-				ZOMBIE(i).num_nodes = zombie_path_search(&ZOMBIE(i), game->level);
-				if (ZOMBIE(i).num_nodes == 0) {
-					ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-					i--;
-				}
-			} else {
-				ZOMBIE(i).dest_x = 0, ZOMBIE(i).dest_y = 0;
-				i--;
+			queue->head = 0, queue->len = len;
+		}
+
+		request = &queue->request[queue->head + queue->len++];
+		request->zombie = i;
+		request->ticket = game->zombie.ticket[i];
+		request->src = zombie_path_end(game, i);
+		request->dest = game->zombie.want[i];
+
+		game->zombie.request[i] = ZOMBIE_WAITING;
+	}
+}
+
+/*
+ * Hand the 'n' node 'path' found for 'request' over to its zombie, after any
+ * nodes it has left to walk, since that is where the new path starts.
+ */
+static void zombie_queue_deliver(struct game_data *game, struct path_request *request, struct node *path, int n)
+{
+	int i = request->zombie, k = game->zombie.num_nodes[i], j;
+
+	game->zombie.request[i] = ZOMBIE_IDLE;
+
+	/* No way there, pick somewhere else next time we think. */
+	if (n == 0) {
+		if (k == 0)
+			game->zombie.dest[i].x = 0, game->zombie.dest[i].y = 0;
+		return;
+	}
+
+	if (k == 0) {
+		memcpy(ZOMBIE_PATH(i) + 1, path + 1, sizeof(struct node) * n);
+		game->zombie.num_nodes[i] = zombie_path_start(game, i, n);
+	} else {
+		for (j = k; j >= 1; j--)
+			ZOMBIE_PATH(i)[n - 1 + j] = ZOMBIE_PATH(i)[j];
+		memcpy(ZOMBIE_PATH(i) + 1, path + 1, sizeof(struct node) * (n - 1));
+		game->zombie.num_nodes[i] = n - 1 + k;
+	}
+
+	game->zombie.dest[i] = request->dest;
+}
+
+/*
+ * Search for queued paths, oldest first, until we have expanded as many nodes
+ * as the budget allows for this frame. A search that runs out of budget picks
+ * up where it left off next frame.
+ */
+static void zombie_queue_serve(struct game_data *game)
+{
+	struct path_queue *queue = &game->path_queue;
+	struct path_request *request;
+	static struct node path[PATH_SIZE];
+	int n, budget = queue->budget;
+
+	while (budget > 0 && queue->len > 0) {
+		request = &queue->request[queue->head];
+
+		/* Skip paths nobody is waiting for anymore. */
+		if (game->zombie.ticket[request->zombie] != request->ticket) {
+			zombie_queue_pop(game);
+			continue;
+		}
+
+		if (!queue->busy) {
+			queue->busy = true;
+			if (!path_begin(&game->level, request->src.x, request->src.y,
+					request->dest.x, request->dest.y, game->pathfinder == PATH_JUMP)) {
+				zombie_queue_deliver(game, request, path, 0);
+				zombie_queue_pop(game);
+				continue;
 			}
 		}
+
+		/* Leave room for whatever is left of the zombie's current path. */
+		n = path_resume(&game->level, &budget, path, PATH_SIZE - game->zombie.num_nodes[request->zombie]);
+		if (n == PATH_PENDING)
+			break;
+
+		zombie_queue_deliver(game, request, path, n);
+		zombie_queue_pop(game);
 	}
 }
+
+/*
+ * Let zombies think from the shared counter in 'zombie_pool' until none are left.
+ */
+static void zombie_think_batches(struct game_data *game)
+{
+	int i, first;
+
+	for (;;) {
+		SDL_mutexP(zombie_pool.lock);
+		first = zombie_pool.next;
+		zombie_pool.next += ZOMBIE_BATCH;
+		SDL_mutexV(zombie_pool.lock);
+
+		if (first >= game->num_zombies)
+			return;
+
+		for (i = first; i < first + ZOMBIE_BATCH && i < game->num_zombies; i++)
+			zombie_think(game, i);
+	}
+}
+
+static int zombie_worker(void *data)
+{
+	(void) data;
+
+	for (;;) {
+		SDL_SemWait(zombie_pool.start);
+		zombie_think_batches(zombie_pool.game);
+		SDL_SemPost(zombie_pool.done);
+	}
+
+	return 0;
+}
+
+void zombie_threads_init(int threads)
+{
+	int i;
+
+	zombie_pool.lock = SDL_CreateMutex();
+	zombie_pool.start = SDL_CreateSemaphore(0);
+	zombie_pool.done = SDL_CreateSemaphore(0);
+
+	/* The main thread thinks as well, so we need one helper less. */
+	for (i = 0; i < threads - 1; i++) {
+		if (SDL_CreateThread(zombie_worker, NULL) == NULL)
+			break;
+		zombie_pool.num_workers++;
+	}
+}
+
+void zombie_move(struct game_data *game)
+{
+	int i, speed;
+	bool seen = false;
+
+	/* Protect against incorrect delta-time readings */
+	if (game->delta_time > 100)
+		return;
+
+	/* Scale the zombie speed depending on the frame-rate */
+	speed = (int) (ZOMBIE_SPEED * ((float) game->delta_time / 1000.0f));
+
+	/* Check if we have collided with the player. */
+	if (zombie_player_caught(game)) {
+		game->player.dead = true;
+		return;
+	}
+
+	/* Decide where every zombie is heading, split between the worker threads.
+	 * Zombies only see the level as it was at the start of the frame. */
+	zombie_pool.game = game;
+	zombie_pool.next = 0;
+
+	for (i = 0; i < zombie_pool.num_workers; i++)
+		SDL_SemPost(zombie_pool.start);
+
+	zombie_think_batches(game);
+
+	for (i = 0; i < zombie_pool.num_workers; i++)
+		SDL_SemWait(zombie_pool.done);
+
+	/* Search for the paths zombies asked for, as far as this frame allows.
+	 * Zombies keep walking what is left of their old paths meanwhile. */
+	zombie_queue_push(game);
+	zombie_queue_serve(game);
+
+	/* Then move them one after the other, in order, so that collisions
+	 * between zombies come out the same however many threads there are. */
+	for (i = 0; i < game->num_zombies; i++) {
+		/* Zombies that can see the player head for their tile. */
+		if (game->zombie.dest[i].x == PLAYER_X && game->zombie.dest[i].y == PLAYER_Y)
+			seen = true;
+
+		if (game->zombie.num_nodes[i] > 0)
+			zombie_follow(game, i, speed);
+		else if (zombie_hunting(game, i))
+			zombie_walk(game, i, speed);
+	}
+
+	/* Should they lose sight of the player, they keep heading there, sharing
+	 * a flow field towards the tile. It has to be built before anyone starts
+	 * thinking again, and only when the player is seen on a new tile. */
+	if (seen && !path_flow_ready(PLAYER_X, PLAYER_Y))
+		path_flow_build(&game->level, PLAYER_X, PLAYER_Y);
+}